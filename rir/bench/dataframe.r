@@ -0,0 +1,29 @@
+# Data frame workloads: construction, column updates, row subsets, grouped
+# aggregation, ordering and merging
+innerIterations <- 5
+n <- 10000L
+
+execute <- function() {
+    id <- seq_len(n)
+    df <- data.frame(id = id, group = id %% 10L, value = as.numeric(id))
+    df$double <- df$value * 2
+
+    sub <- df[df$group == 3L, ]
+    totals <- tapply(df$value, df$group, sum)
+    counts <- aggregate(value ~ group, data = df, FUN = length)
+    ordered <- df[order(-df$value), ]
+    merged <- merge(sub[1:100, c("id", "value")], df[, c("id", "double")],
+                    by = "id")
+
+    list(rows = nrow(sub), totals = totals, counts = counts$value,
+         first = ordered$id[[1]], merged = sum(merged$double))
+}
+
+verifyResult <- function(result) {
+    m <- as.numeric(n)
+    result$rows == n / 10 && sum(result$totals) == m * (m + 1) / 2 &&
+        result$totals[["0"]] == 10 * (n / 10) * (n / 10 + 1) / 2 &&
+        all(result$counts == n / 10) && result$first == n &&
+        # The ids 3, 13, ..., 993, doubled
+        result$merged == 2 * (100 * 3 + 10 * 99 * 100 / 2)
+}
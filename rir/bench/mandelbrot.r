@@ -0,0 +1,63 @@
+# Are-we-fast-yet Mandelbrot: scalar floating point and bit operations
+innerIterations <- 1
+size <- 500
+
+mandelbrot <- function(size) {
+    sum <- 0
+    byteAcc <- 0
+    bitNum <- 0
+
+    y <- 0
+    while (y < size) {
+        ci <- (2.0 * y / size) - 1.0
+        x <- 0
+
+        while (x < size) {
+            zrzr <- 0.0
+            zi <- 0.0
+            zizi <- 0.0
+            cr <- (2.0 * x / size) - 1.5
+
+            z <- 0
+            notDone <- TRUE
+            escape <- 0
+            while (notDone && (z < 50)) {
+                zr <- zrzr - zizi + cr
+                zi <- 2.0 * zr * zi + ci
+
+                zrzr <- zr * zr
+                zizi <- zi * zi
+
+                if ((zrzr + zizi) > 4.0) {
+                    notDone <- FALSE
+                    escape <- 1
+                }
+                z <- z + 1
+            }
+
+            byteAcc <- bitwShiftL(byteAcc, 1) + escape
+            bitNum <- bitNum + 1
+
+            if (bitNum == 8) {
+                sum <- bitwXor(sum, byteAcc)
+                byteAcc <- 0
+                bitNum <- 0
+            } else if (x == (size - 1)) {
+                byteAcc <- bitwShiftL(byteAcc, 8 - bitNum)
+                sum <- bitwXor(sum, byteAcc)
+                byteAcc <- 0
+                bitNum <- 0
+            }
+            x <- x + 1
+        }
+        y <- y + 1
+    }
+    sum
+}
+
+execute <- function() mandelbrot(size)
+
+verifyResult <- function(result) {
+    expected <- c("1" = 128, "10" = 127, "500" = 191, "750" = 50)
+    result == expected[[as.character(size)]]
+}
@@ -0,0 +1,67 @@
+# The n-body program of the computer language shootout, vectorized over
+# matrices the way the in-tree nbody_2_regression.r is
+innerIterations <- 1
+steps <- 1000
+
+solarMass <- 4 * pi * pi
+daysPerYear <- 365.24
+nBodies <- 5
+
+initialR <- matrix(c(
+    0, 0, 0,
+    4.84143144246472090e+00, -1.16032004402742839e+00,
+    -1.03622044471123109e-01,
+    8.34336671824457987e+00, 4.12479856412430479e+00,
+    -4.03523417114321381e-01,
+    1.28943695621391310e+01, -1.51111514016986312e+01,
+    -2.23307578892655734e-01,
+    1.53796971148509165e+01, -2.59193146099879641e+01,
+    1.79258772950371181e-01), 3)
+
+initialV <- matrix(c(
+    0, 0, 0,
+    1.66007664274403694e-03, 7.69901118419740425e-03,
+    -6.90460016972063023e-05,
+    -2.76742510726862411e-03, 4.99852801234917238e-03,
+    2.30417297573763929e-05,
+    2.96460137564761618e-03, 2.37847173959480950e-03,
+    -2.96589568540237556e-05,
+    2.68067772490389322e-03, 1.62824170038242295e-03,
+    -9.51592254519715870e-05) * daysPerYear, 3)
+
+mass <- c(1, 9.54791938424326609e-04, 2.85885980666130812e-04,
+          4.36624404335156298e-05, 5.15138902046611451e-05) * solarMass
+
+distances <- function(r) {
+    drr <- array(dim = c(nBodies, nBodies, 3))
+    for (i in 1:nBodies)
+        for (j in 1:nBodies)
+            drr[i, j, ] <- r[, i] - r[, j]
+    drr
+}
+
+energy <- function(r, v) {
+    drr <- distances(r)
+    distance <- sqrt(t(colSums(aperm(drr * drr))))
+    q <- (mass %o% mass) / distance
+    sum(0.5 * mass * colSums(v * v)) - sum(q[upper.tri(q)])
+}
+
+execute <- function() {
+    r <- initialR
+    v <- initialV
+    v[, 1] <- -(v %*% mass) / solarMass
+    for (s in 1:steps) {
+        drr <- distances(r)
+        distance <- sqrt(t(colSums(aperm(drr * drr))))
+        mag <- 0.01 / (distance * distance * distance)
+        diag(mag) <- 0
+        for (d in 1:3)
+            v[d, ] <- v[d, ] - as.vector((drr[, , d] * mag) %*% mass)
+        r <- r + 0.01 * v
+    }
+    energy(r, v)
+}
+
+# The reference output of the shootout for 1000 steps
+verifyResult <- function(result) abs(result - -0.169087605) < 1e-9
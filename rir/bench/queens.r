@@ -0,0 +1,41 @@
+# Are-we-fast-yet Queens: backtracking search for the eight queens problem
+innerIterations <- 20
+
+queens <- function() {
+    freeRows <- rep(TRUE, 8)
+    freeMaxs <- rep(TRUE, 16)
+    freeMins <- rep(TRUE, 16)
+    queenRows <- rep(-1L, 8)
+
+    getRowColumn <- function(r, c)
+        freeRows[[r]] && freeMaxs[[c + r]] && freeMins[[c - r + 8]]
+    setRowColumn <- function(r, c, v) {
+        freeRows[[r]] <<- v
+        freeMaxs[[c + r]] <<- v
+        freeMins[[c - r + 8]] <<- v
+    }
+    placeQueen <- function(c) {
+        for (r in 1:8) {
+            if (getRowColumn(r, c)) {
+                queenRows[[r]] <<- c
+                setRowColumn(r, c, FALSE)
+                if (c == 8)
+                    return(TRUE)
+                if (placeQueen(c + 1))
+                    return(TRUE)
+                setRowColumn(r, c, TRUE)
+            }
+        }
+        FALSE
+    }
+    placeQueen(1)
+}
+
+execute <- function() {
+    result <- TRUE
+    for (i in 1:10)
+        result <- result && queens()
+    result
+}
+
+verifyResult <- function(result) isTRUE(result)
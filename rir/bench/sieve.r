@@ -0,0 +1,21 @@
+# Are-we-fast-yet Sieve: the primes up to 5000 in a logical vector
+innerIterations <- 20
+
+sieve <- function(flags, size) {
+    primeCount <- 0
+    for (i in 2:size) {
+        if (flags[[i]]) {
+            primeCount <- primeCount + 1
+            k <- i + i
+            while (k <= size) {
+                flags[[k]] <- FALSE
+                k <- k + i
+            }
+        }
+    }
+    primeCount
+}
+
+execute <- function() sieve(rep(TRUE, 5000), 5000)
+
+verifyResult <- function(result) result == 669
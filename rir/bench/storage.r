@@ -0,0 +1,24 @@
+# Are-we-fast-yet Storage: allocates a tree of lists to stress the GC
+innerIterations <- 5
+
+execute <- function() {
+    count <- 0
+    seed <- 74755
+    nextRandom <- function() {
+        seed <<- bitwAnd((seed * 1309) + 13849, 65535)
+        seed
+    }
+    buildTreeDepth <- function(depth) {
+        count <<- count + 1
+        if (depth == 1)
+            return(vector("list", nextRandom() %% 10 + 1))
+        arr <- vector("list", 4)
+        for (i in 1:4)
+            arr[[i]] <- buildTreeDepth(depth - 1)
+        arr
+    }
+    buildTreeDepth(7)
+    count
+}
+
+verifyResult <- function(result) result == 5461
@@ -0,0 +1,45 @@
+# Are-we-fast-yet Towers: towers of hanoi with 13 disks, recursion and
+# closures updating their enclosing environment
+innerIterations <- 2
+
+towers <- function(disks) {
+    piles <- list(integer(0), integer(0), integer(0))
+    moves <- 0L
+
+    pushDisk <- function(disk, pile) {
+        top <- piles[[pile]]
+        if (length(top) && disk >= top[[length(top)]])
+            stop("cannot put a big disk on a smaller one")
+        piles[[pile]] <<- c(top, disk)
+    }
+    popDiskFrom <- function(pile) {
+        top <- piles[[pile]]
+        if (!length(top))
+            stop("attempting to remove a disk from an empty pile")
+        piles[[pile]] <<- top[-length(top)]
+        top[[length(top)]]
+    }
+    moveTopDisk <- function(from, to) {
+        pushDisk(popDiskFrom(from), to)
+        moves <<- moves + 1L
+    }
+    moveDisks <- function(disks, from, to) {
+        if (disks == 1) {
+            moveTopDisk(from, to)
+        } else {
+            other <- 6L - from - to
+            moveDisks(disks - 1, from, other)
+            moveTopDisk(from, to)
+            moveDisks(disks - 1, other, to)
+        }
+    }
+
+    for (i in disks:1)
+        pushDisk(i, 1L)
+    moveDisks(disks, 1L, 2L)
+    moves
+}
+
+execute <- function() towers(13L)
+
+verifyResult <- function(result) result == 8191L
@@ -0,0 +1,38 @@
+# Vector workloads: arithmetic, reductions, logical indexing, sorting and a
+# scalar loop over a long vector. The results are checked against closed
+# forms.
+innerIterations <- 5
+n <- 100000L
+
+execute <- function() {
+    a <- seq_len(n)
+    x <- as.numeric(a)
+
+    squares <- sum(x * x)
+    total <- cumsum(x)[[n]]
+    thirds <- length(which(a %% 3L == 0L))
+
+    odd <- a
+    odd[odd %% 2L == 0L] <- 0L
+    oddSum <- sum(as.numeric(odd))
+
+    sorted <- sort(c(rev(a), a))
+    sortedOk <- identical(sorted[c(TRUE, FALSE)], a)
+
+    clamped <- sum(pmin(pmax(x, 10), n - 10))
+
+    dot <- 0
+    for (i in seq_along(x))
+        dot <- dot + x[[i]] * x[[i]]
+
+    c(squares, total, thirds, oddSum, sortedOk, clamped, dot)
+}
+
+verifyResult <- function(result) {
+    m <- as.numeric(n)
+    squares <- m * (m + 1) * (2 * m + 1) / 6
+    # pmax raises 1..9 by 45 in total, pmin lowers the last 10 by 55
+    expected <- c(squares, m * (m + 1) / 2, n %/% 3L, ceiling(m / 2)^2, 1,
+                  m * (m + 1) / 2 - 10, squares)
+    identical(result, expected)
+}
@@ -86,6 +86,13 @@
     V(all, "all")                                                              \
     V(FUN, "FUN")                                                              \
     V(forceAndCall, "forceAndCall")                                            \
-    V(Recall, "Recall")
+    V(Recall, "Recall")                                                        \
+    V(DotGeneric, ".Generic")                                                  \
+    V(DotGroup, ".Group")                                                      \
+    V(DotClass, ".Class")                                                      \
+    V(DotMethod, ".Method")                                                    \
+    V(DotGenericCallEnv, ".GenericCallEnv")                                    \
+    V(DotGenericDefEnv, ".GenericDefEnv")                                      \
+    V(S3MethodsTable, ".__S3MethodsTable__.")
 
 #endif // SYMBOLS_LIST_H_
@@ -6,17 +6,24 @@
 #include "R/Funtab.h"
 #include "R/Serialize.h"
 #include "compiler/backend.h"
+#include "compiler/compile_corpus.h"
 #include "compiler/compiler.h"
 #include "compiler/log/debug.h"
+#include "compiler/native/background_compilation.h"
+#include "compiler/native/code_cache.h"
 #include "compiler/parameter.h"
 #include "compiler/test/PirCheck.h"
 #include "compiler/test/PirTests.h"
+#include "interpreter/instance.h"
 #include "interpreter/interp_incl.h"
 #include "ir/BC.h"
 #include "ir/Compiler.h"
+#include "runtime/JitStats.h"
 
 #include <cassert>
+#include <chrono>
 #include <cstdio>
+#include <functional>
 #include <list>
 #include <memory>
 #include <string>
@@ -284,8 +291,41 @@ REXPORT SEXP pirSetDebugFlags(SEXP debugFlags) {
     return R_NilValue;
 }
 
+// Runs compile on a new module and deletes the module afterwards, also if an R
+// error longjmps out of the compilation. A leaked module would keep its arena
+// installed for all later modules.
+static void withModule(const std::function<void(pir::Module*)>& compile) {
+    struct Job {
+        pir::Module* m;
+        const std::function<void(pir::Module*)>* compile;
+    };
+    Job job = {new pir::Module, &compile};
+    auto cont = PROTECT(R_MakeUnwindCont());
+    R_UnwindProtect(
+        [](void* data) -> SEXP {
+            auto job = static_cast<Job*>(data);
+            (*job->compile)(job->m);
+            return R_NilValue;
+        },
+        &job,
+        [](void* data, Rboolean jump) {
+            if (jump)
+                delete static_cast<Job*>(data)->m;
+        },
+        &job, cont);
+    UNPROTECT(1);
+    delete job.m;
+}
+
+// Compilations per LLVM tier, see PIR_LLVM_TIERING
+static struct {
+    size_t compiles[2] = {0, 0};
+    double compileTime[2] = {0, 0};
+    size_t tierUps = 0;
+} tierStats;
+
 SEXP pirCompile(SEXP what, const Context& assumptions, const std::string& name,
-                const pir::DebugOptions& debug) {
+                const pir::DebugOptions& debug, bool background, bool tier1) {
     if (!isValidClosureSEXP(what)) {
         Rf_error("not a compiled closure");
     }
@@ -296,37 +336,151 @@ SEXP pirCompile(SEXP what, const Context& assumptions, const std::string& name,
     PROTECT(what);
 
     bool dryRun = debug.includes(pir::DebugFlag::DryRun);
+    if (!dryRun && pir::CompileCorpus::capturing())
+        pir::CompileCorpus::capture(what, assumptions, name);
+
+    auto start = std::chrono::steady_clock::now();
     // compile to pir
-    pir::Module* m = new pir::Module;
-    pir::StreamLogger logger(debug);
-    logger.title("Compiling " + name);
-    pir::Compiler cmp(m, logger);
-    pir::Backend backend(logger, name);
-    cmp.compileClosure(what, name, assumptions, true,
-                       [&](pir::ClosureVersion* c) {
-                           logger.flush();
-                           cmp.optimizeModule();
-
-                           auto fun = backend.getOrCompile(c);
-
-                           // Install
-                           if (dryRun)
-                               return;
-
-                           Protect p(fun->container());
-                           DispatchTable::unpack(BODY(what))->insert(fun);
-                       },
-                       [&]() {
-                           if (debug.includes(pir::DebugFlag::ShowWarnings))
-                               std::cerr << "Compilation failed\n";
-                       },
-                       {});
-
-    delete m;
+    withModule([&](pir::Module* m) {
+        pir::StreamLogger logger(debug);
+        logger.title("Compiling " + name);
+        pir::Compiler cmp(m, logger);
+        pir::Backend backend(logger, name, background, tier1);
+        cmp.compileClosure(
+            what, name, assumptions, true,
+            [&](pir::ClosureVersion* c) {
+                logger.flush();
+                cmp.optimizeModule();
+
+                auto fun = backend.getOrCompile(c);
+                if (tier1)
+                    fun->flags.set(Function::Tier1);
+                std::chrono::duration<double> pirTime =
+                    std::chrono::steady_clock::now() - start;
+                fun->stats.pirTime = pirTime.count();
+
+                // Install
+                if (dryRun)
+                    return;
+
+                Protect p(fun->container());
+                JitStats::registerClosure(what, name);
+                backend.install(DispatchTable::unpack(BODY(what)), fun);
+            },
+            [&]() {
+                if (debug.includes(pir::DebugFlag::ShowWarnings))
+                    std::cerr << "Compilation failed\n";
+            },
+            {});
+    });
+    std::chrono::duration<double> duration =
+        std::chrono::steady_clock::now() - start;
+    auto tier = tier1 ? 0 : 1;
+    tierStats.compiles[tier]++;
+    tierStats.compileTime[tier] += duration.count();
     UNPROTECT(1);
     return what;
 }
 
+REXPORT SEXP rirTierStats() {
+    const char* names[] = {"tier1Compiles", "tier1CompileTime",
+                           "tier2Compiles", "tier2CompileTime",
+                           "tierUps",       ""};
+    SEXP res = PROTECT(Rf_mkNamed(REALSXP, names));
+    REAL(res)[0] = tierStats.compiles[0];
+    REAL(res)[1] = tierStats.compileTime[0];
+    REAL(res)[2] = tierStats.compiles[1];
+    REAL(res)[3] = tierStats.compileTime[1];
+    REAL(res)[4] = tierStats.tierUps;
+    UNPROTECT(1);
+    return res;
+}
+
+REXPORT SEXP rirJitStats(SEXP what, SEXP reset) {
+    SEXP res = PROTECT(JitStats::report(what));
+    if (Rf_asLogical(reset) == TRUE)
+        JitStats::reset(what);
+    UNPROTECT(1);
+    return res;
+}
+
+REXPORT SEXP rirCompileCorpus(SEXP dir) {
+    static std::string path;
+    if (dir == R_NilValue) {
+        pir::Parameter::COMPILE_CORPUS = nullptr;
+        return R_NilValue;
+    }
+    if (TYPEOF(dir) != STRSXP || Rf_length(dir) != 1)
+        Rf_error("must provide a string path");
+    path = CHAR(STRING_ELT(dir, 0));
+    pir::Parameter::COMPILE_CORPUS = path.c_str();
+    return R_NilValue;
+}
+
+REXPORT SEXP rirCompileReplay(SEXP dir, SEXP repetitions) {
+    if (TYPEOF(dir) != STRSXP || Rf_length(dir) != 1)
+        Rf_error("must provide a string path");
+    auto n = Rf_asInteger(repetitions);
+    if (n == NA_INTEGER || n < 1)
+        Rf_error("repetitions must be a positive number");
+    return pir::CompileCorpus::replay(CHAR(STRING_ELT(dir, 0)), n);
+}
+
+REXPORT SEXP rirScalarStats(SEXP reset) {
+    const char* names[] = {"boxed", "reused", "unboxed", "updatedInPlace", ""};
+    SEXP res = PROTECT(Rf_mkNamed(REALSXP, names));
+    REAL(res)[0] = scalarStats.boxed;
+    REAL(res)[1] = scalarStats.reused;
+    REAL(res)[2] = scalarStats.unboxed;
+    REAL(res)[3] = scalarStats.updatedInPlace;
+    if (Rf_asLogical(reset) == TRUE)
+        scalarStats = ScalarStats();
+    UNPROTECT(1);
+    return res;
+}
+
+REXPORT SEXP rirOsrStats(SEXP reset) {
+    const char* names[] = {"compiles", "failures", "entries", "abandoned", ""};
+    SEXP res = PROTECT(Rf_mkNamed(REALSXP, names));
+    REAL(res)[0] = osrStats.compiles;
+    REAL(res)[1] = osrStats.failures;
+    REAL(res)[2] = osrStats.entries;
+    REAL(res)[3] = osrStats.abandoned;
+    if (Rf_asLogical(reset) == TRUE)
+        osrStats = OsrStats();
+    UNPROTECT(1);
+    return res;
+}
+
+REXPORT SEXP rirBackgroundCompileStats() {
+    auto stats = pir::BackgroundCompilation::stats();
+
+    const char* names[] = {"submitted",
+                           "installed",
+                           "queueDepth",
+                           "maxQueueDepth",
+                           "compileTime",
+                           "meanInstallLatency",
+                           "maxInstallLatency",
+                           ""};
+    SEXP res = PROTECT(Rf_mkNamed(REALSXP, names));
+    REAL(res)[0] = stats.submitted;
+    REAL(res)[1] = stats.installed;
+    REAL(res)[2] = stats.queueDepth;
+    REAL(res)[3] = stats.maxQueueDepth;
+    REAL(res)[4] = stats.compileTime;
+    REAL(res)[5] =
+        stats.installed ? stats.totalInstallLatency / stats.installed : 0;
+    REAL(res)[6] = stats.maxInstallLatency;
+    UNPROTECT(1);
+    return res;
+}
+
+REXPORT SEXP rirBackgroundCompileDrain() {
+    pir::BackgroundCompilation::drain();
+    return R_NilValue;
+}
+
 REXPORT SEXP rirInvocationCount(SEXP what) {
     if (!isValidClosureSEXP(what)) {
         Rf_error("not a compiled closure");
@@ -341,6 +495,81 @@ REXPORT SEXP rirInvocationCount(SEXP what) {
     return res;
 }
 
+// Measures the cost of dispatching on a table of growing size. The table is
+// filled with synthetic versions of what, each specialized to a different
+// context, and queried round robin with the contexts of all versions. Reports
+// nanoseconds per call for the plain linear lookup and for dispatch through
+// the context cache.
+REXPORT SEXP rirDispatchBenchmark(SEXP what, SEXP versionsSexp,
+                                  SEXP iterationsSexp) {
+    if (!isValidClosureSEXP(what))
+        Rf_error("not a compiled closure");
+    auto baseline = DispatchTable::unpack(BODY(what))->baseline();
+    int versions = Rf_asInteger(versionsSexp);
+    int iterations = Rf_asInteger(iterationsSexp);
+
+    auto table = DispatchTable::create();
+    if (versions < 1 || (size_t)versions >= table->capacity())
+        Rf_error("number of versions must be between 1 and %d",
+                 (int)table->capacity() - 1);
+    if (iterations < 1)
+        Rf_error("number of iterations must be positive");
+    PROTECT(table->container());
+    table->baseline(baseline);
+
+    const char* names[] = {"versions", "linear", "cached", ""};
+    SEXP res = PROTECT(Rf_mkNamed(VECSXP, names));
+    SEXP vs = Rf_allocVector(INTSXP, versions);
+    SET_VECTOR_ELT(res, 0, vs);
+    SEXP linear = Rf_allocVector(REALSXP, versions);
+    SET_VECTOR_ELT(res, 1, linear);
+    SEXP cached = Rf_allocVector(REALSXP, versions);
+    SET_VECTOR_ELT(res, 2, cached);
+
+    auto time = [&](const std::function<size_t(size_t)>& f) {
+        size_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            sink += f(i);
+        std::chrono::duration<double, std::nano> d =
+            std::chrono::steady_clock::now() - start;
+        // Keep the loop alive
+        if (sink == (size_t)-1)
+            Rprintf(" ");
+        return d.count() / iterations;
+    };
+
+    std::vector<Context> contexts;
+    for (int v = 1; v <= versions; ++v) {
+        Context c(pir::Compiler::minimalContext);
+        for (size_t b = 0; b < Context::NUM_TYPED_ARGS; ++b) {
+            if (v & (1 << b))
+                c.setEager(b);
+            if (v & (1 << (b + Context::NUM_TYPED_ARGS)))
+                c.setNotObj(b);
+        }
+        contexts.push_back(c);
+
+        SEXP store = Rf_allocVector(EXTERNALSXP, sizeof(Function));
+        new (DATAPTR(store)) Function(
+            sizeof(Function), baseline->body()->container(), {},
+            FunctionSignature(FunctionSignature::Environment::CalleeCreated,
+                              FunctionSignature::OptimizationLevel::Optimized),
+            c);
+        table->insert(Function::unpack(store));
+
+        INTEGER(vs)[v - 1] = v;
+        REAL(linear)[v - 1] = time(
+            [&](size_t i) { return table->lookup(contexts[i % v]); });
+        REAL(cached)[v - 1] = time([&](size_t i) {
+            return (size_t)table->dispatch(contexts[i % v]);
+        });
+    }
+
+    UNPROTECT(2);
+    return res;
+}
+
 REXPORT SEXP pirCompileWrapper(SEXP what, SEXP name, SEXP debugFlags,
                                SEXP debugStyle) {
     if (debugFlags != R_NilValue &&
@@ -421,10 +650,73 @@ SEXP rirOptDefaultOpts(SEXP closure, const Context& assumptions, SEXP name) {
     if (TYPEOF(name) == SYMSXP)
         n = CHAR(PRINTNAME(name));
     // PIR can only optimize closures, not expressions
-    if (isValidClosureSEXP(closure))
-        return pirCompile(closure, assumptions, n, PirDebug);
-    else
+    if (isValidClosureSEXP(closure)) {
+        closure = pirCompile(closure, assumptions, n, PirDebug,
+                             pir::Parameter::BACKGROUND_COMPILE,
+                             pir::Parameter::PIR_LLVM_TIERING);
+        if (pir::CodeCache::enabled())
+            pir::CodeCache::store(closure, assumptions);
         return closure;
+    } else
+        return closure;
+}
+
+// Recompile a hot tier-1 version with the full LLVM pipeline. PIR versions are
+// not kept around, so this reruns the whole pipeline for the same context. The
+// type feedback gathered in the meantime is used, the tier-1 version is
+// replaced on insertion.
+SEXP rirOptTier2(SEXP closure, const Context& assumptions, SEXP name) {
+    std::string n = "";
+    if (TYPEOF(name) == SYMSXP)
+        n = CHAR(PRINTNAME(name));
+    if (!isValidClosureSEXP(closure))
+        return closure;
+    tierStats.tierUps++;
+    return pirCompile(closure, assumptions, n, PirDebug,
+                      pir::Parameter::BACKGROUND_COMPILE, false);
+}
+
+// Compiles the continuation of the baseline version of closure at pc, for OSR
+// of a loop or for a deoptless deopt. The result is not inserted into the
+// dispatch table, the caller jumps into it directly. It is not protected.
+Function* rirCompileContinuation(SEXP closure, Opcode* pc, R_bcstack_t* stack,
+                                 size_t stackSize, SEXP name) {
+    std::string n = "";
+    if (TYPEOF(name) == SYMSXP)
+        n = CHAR(PRINTNAME(name));
+    n += "@osr";
+
+    // The values on the stack are known exactly, their types are facts
+    std::vector<pir::PirType> stackTypes;
+    for (size_t i = 0; i < stackSize; ++i) {
+        auto v = stack[i].u.sxpval;
+        stackTypes.push_back(TYPEOF(v) == PROMSXP ? pir::PirType::any()
+                                                  : pir::PirType(v));
+    }
+
+    Function* res = nullptr;
+    withModule([&](pir::Module* m) {
+        pir::StreamLogger logger(PirDebug);
+        logger.title("Compiling continuation " + n);
+        pir::Compiler cmp(m, logger);
+        pir::Backend backend(logger, n);
+        cmp.compileContinuation(
+            closure, n, pc, stackTypes,
+            [&](pir::ClosureVersion* c) {
+                logger.flush();
+                cmp.optimizeModule();
+                res = backend.getOrCompile(c);
+                // Keep alive until the backend patched in the native code
+                R_PreserveObject(res->container());
+            },
+            [&]() {
+                if (PirDebug.includes(pir::DebugFlag::ShowWarnings))
+                    std::cerr << "Compilation failed\n";
+            });
+    });
+    if (res)
+        R_ReleaseObject(res->container());
+    return res;
 }
 
 SEXP rirOptDefaultOptsDryrun(SEXP closure, const Context& assumptions,
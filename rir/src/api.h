@@ -8,10 +8,20 @@
 
 #define REXPORT extern "C"
 
+namespace rir {
+enum class Opcode : uint8_t;
+struct Function;
+} // namespace rir
+
 extern int R_ENABLE_JIT;
 extern rir::pir::DebugOptions PirDebug;
 
 REXPORT SEXP rirInvocationCount(SEXP what);
+REXPORT SEXP rirDispatchBenchmark(SEXP what, SEXP versions, SEXP iterations);
+REXPORT SEXP rirTierStats();
+REXPORT SEXP rirJitStats(SEXP what, SEXP reset);
+REXPORT SEXP rirCompileCorpus(SEXP dir);
+REXPORT SEXP rirCompileReplay(SEXP dir, SEXP repetitions);
 REXPORT SEXP pirCompileWrapper(SEXP closure, SEXP name, SEXP debugFlags,
                                SEXP debugStyle);
 REXPORT SEXP rirCompile(SEXP what, SEXP env);
@@ -19,8 +29,13 @@ REXPORT SEXP pirTests();
 REXPORT SEXP pirCheck(SEXP f, SEXP check, SEXP env);
 REXPORT SEXP pirSetDebugFlags(SEXP debugFlags);
 SEXP pirCompile(SEXP closure, const rir::Context& assumptions,
-                const std::string& name, const rir::pir::DebugOptions& debug);
+                const std::string& name, const rir::pir::DebugOptions& debug,
+                bool background = false, bool tier1 = false);
 extern SEXP rirOptDefaultOpts(SEXP closure, const rir::Context&, SEXP name);
+extern SEXP rirOptTier2(SEXP closure, const rir::Context&, SEXP name);
+extern rir::Function* rirCompileContinuation(SEXP closure, rir::Opcode* pc,
+                                             R_bcstack_t* stack,
+                                             size_t stackSize, SEXP name);
 extern SEXP rirOptDefaultOptsDryrun(SEXP closure, const rir::Context&,
                                     SEXP name);
 REXPORT SEXP rirSerialize(SEXP data, SEXP file);
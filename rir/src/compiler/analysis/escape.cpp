@@ -0,0 +1,223 @@
+#include "escape.h"
+#include "R/BuiltinIds.h"
+#include "R/r.h"
+#include "compiler/pir/pir_impl.h"
+#include "compiler/util/visitor.h"
+
+#include <cmath>
+#include <unordered_map>
+
+namespace rir {
+namespace pir {
+
+static bool isCandidate(CallSafeBuiltin* b, PirType& element) {
+    if (b->builtinId == blt("list")) {
+        element = PirType::val();
+        return true;
+    }
+    if (b->builtinId != blt("c") || b->nCallArgs() == 0)
+        return false;
+    for (auto t : {RType::real, RType::integer, RType::logical}) {
+        auto elt = PirType(t).simpleScalar();
+        bool all = true;
+        b->eachCallArg([&](Value* v) {
+            if (!v->type.isA(elt))
+                all = false;
+        });
+        if (all) {
+            element = elt;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Phis of vectors are split into one phi per element, which has to stay in a
+// register across the merge
+static constexpr size_t MAX_PHI_LENGTH = 4;
+
+static bool isList(const EscapeAnalysis::Allocation& a) {
+    return a.root->builtinId == blt("list");
+}
+
+// Zero based index of a constant, in bounds vector index
+static bool constantIndex(Value* idx, size_t length, size_t& res) {
+    auto ld = LdConst::Cast(idx);
+    if (!ld)
+        return false;
+    auto c = ld->c();
+    double i;
+    if (IS_SIMPLE_SCALAR(c, INTSXP) && INTEGER(c)[0] != NA_INTEGER)
+        i = INTEGER(c)[0];
+    else if (IS_SIMPLE_SCALAR(c, REALSXP) && !ISNAN(REAL(c)[0]))
+        i = REAL(c)[0];
+    else
+        return false;
+    if (i < 1 || i > length || std::floor(i) != i)
+        return false;
+    res = (size_t)i - 1;
+    return true;
+}
+
+EscapeAnalysis::EscapeAnalysis(Code* code) {
+    std::unordered_map<Instruction*, Allocation> candidates;
+    bool any = false;
+
+    // Optimistically every element assignment and phi is part of an
+    // aggregate, the ones which are not are removed below
+    Visitor::run(code->entry, [&](Instruction* i) {
+        if (i->bb()->isDeopt())
+            return;
+        PirType element;
+        if (auto b = CallSafeBuiltin::Cast(i)) {
+            if (isCandidate(b, element)) {
+                candidates[i] = {i, b, b->nCallArgs(), element, 0, {}, {}, {}};
+                any = true;
+            }
+        } else if (Subassign1_1D::Cast(i) || Subassign2_1D::Cast(i) ||
+                   Phi::Cast(i)) {
+            candidates[i] = {i, nullptr, 0, PirType::bottom(), 0, {}, {}, {}};
+        }
+    });
+    if (!any)
+        return;
+
+    auto candidate = [&](Value* v) -> Allocation* {
+        auto vi = Instruction::Cast(v);
+        if (!vi)
+            return nullptr;
+        auto c = candidates.find(vi);
+        return c == candidates.end() ? nullptr : &c->second;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::unordered_set<Instruction*> removed;
+
+        // Propagate length and element type from the allocations
+        for (auto& c : candidates) {
+            auto& a = c.second;
+            auto i = a.alloc;
+            if (CallSafeBuiltin::Cast(i))
+                continue;
+            if (auto phi = Phi::Cast(i)) {
+                phi->eachArg([&](BB*, Value* v) {
+                    auto in = candidate(v);
+                    if (!in) {
+                        removed.insert(i);
+                        return;
+                    }
+                    if (!in->root)
+                        return;
+                    if (isList(*in) || in->length > MAX_PHI_LENGTH ||
+                        (a.root && (in->length != a.length ||
+                                    in->element != a.element))) {
+                        removed.insert(i);
+                    } else if (!a.root) {
+                        a.root = in->root;
+                        a.length = in->length;
+                        a.element = in->element;
+                        changed = true;
+                    }
+                });
+                continue;
+            }
+            // An element assignment `vec[[idx]] <- val`
+            auto val = i->arg(0).val();
+            auto vec = candidate(i->arg(1).val());
+            if (!vec || val == i->arg(1).val()) {
+                removed.insert(i);
+                continue;
+            }
+            if (!vec->root || a.root)
+                continue;
+            if (isList(*vec) || !val->type.isA(vec->element) ||
+                !constantIndex(i->arg(2).val(), vec->length, a.assigned)) {
+                removed.insert(i);
+                continue;
+            }
+            a.root = vec->root;
+            a.length = vec->length;
+            a.element = vec->element;
+            changed = true;
+        }
+        if (!changed)
+            for (auto& c : candidates)
+                if (!c.second.root)
+                    removed.insert(c.first);
+
+        for (auto& c : candidates) {
+            auto& a = c.second;
+            a.reads.clear();
+            a.lengths.clear();
+            a.deoptUses.clear();
+        }
+
+        Visitor::run(code->entry, [&](Instruction* i) {
+            i->eachArg([&](Value* v) {
+                auto ap = candidate(v);
+                // Not known yet to be a small vector, checked once it is
+                if (!ap || !ap->root || removed.count(ap->alloc))
+                    return;
+                auto& a = *ap;
+
+                if (i->bb()->isDeopt()) {
+                    a.deoptUses.insert(i->bb());
+                    return;
+                }
+                if (Length::Cast(i)) {
+                    a.lengths.push_back(i);
+                    return;
+                }
+                // The element replaces the read, it must be at least as
+                // precise
+                auto element = [&](size_t idx) {
+                    if (a.alloc == a.root)
+                        return a.root->callArg(idx).val()->type.isA(i->type);
+                    return a.element.isA(i->type);
+                };
+                size_t idx;
+                if (auto e = Extract2_1D::Cast(i)) {
+                    if (e->vec() == v && e->idx() != v &&
+                        constantIndex(e->idx(), a.length, idx) &&
+                        element(idx)) {
+                        a.reads.push_back({i, idx});
+                        return;
+                    }
+                } else if (auto e = Extract1_1D::Cast(i)) {
+                    // On a list `[` creates a new list
+                    if (!isList(a) && e->vec() == v && e->idx() != v &&
+                        constantIndex(e->idx(), a.length, idx) &&
+                        element(idx)) {
+                        a.reads.push_back({i, idx});
+                        return;
+                    }
+                } else if (candidate(i) && !CallSafeBuiltin::Cast(i) &&
+                           !removed.count(i)) {
+                    // Used as vector by an element assignment, or as an input
+                    // of a phi, which are part of the aggregate themselves
+                    if (Phi::Cast(i) ||
+                        (i->arg(1).val() == v && i->arg(0).val() != v &&
+                         i->arg(2).val() != v))
+                        return;
+                }
+                removed.insert(a.alloc);
+            });
+        });
+
+        for (auto r : removed) {
+            candidates.erase(r);
+            changed = true;
+        }
+    }
+
+    Visitor::run(code->entry, [&](Instruction* i) {
+        auto c = candidates.find(i);
+        if (c != candidates.end())
+            nonEscaping_.push_back(c->second);
+    });
+}
+
+} // namespace pir
+} // namespace rir
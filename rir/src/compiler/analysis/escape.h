@@ -0,0 +1,60 @@
+#ifndef PIR_ESCAPE_H
+#define PIR_ESCAPE_H
+
+#include "compiler/pir/pir.h"
+#include "compiler/pir/type.h"
+
+#include <unordered_set>
+#include <vector>
+
+namespace rir {
+namespace pir {
+
+class CallSafeBuiltin;
+
+/*
+ * Flow insensitive escape analysis for small fixed length vectors, i.e.
+ * results of `c()` on simple scalars of one type and of `list()`.
+ *
+ * Such a vector value is either the allocation itself, an assignment of a
+ * simple scalar of the element type at a constant, in bounds index, or a phi
+ * of vectors of the same length. Together they form an aggregate which can be
+ * kept in one SSA value per element, also across loop iterations.
+ *
+ * A vector value does not escape if every use is either
+ *  - a read of one element at a constant, in bounds index,
+ *  - its length,
+ *  - an element assignment or phi which does not escape,
+ *  - or located in a deopt branch. There the object is needed to reconstruct
+ *    the interpreter state, but it can be rematerialized on the way out.
+ */
+class EscapeAnalysis {
+  public:
+    struct Allocation {
+        // The `c()` or `list()` call, an element assignment or a phi
+        Instruction* alloc;
+        // The allocation this vector is derived from, the template to
+        // rematerialize it
+        CallSafeBuiltin* root;
+        size_t length;
+        PirType element;
+        // For element assignments, the zero based index they write
+        size_t assigned;
+        // Element reads, with the zero based index they read
+        std::vector<std::pair<Instruction*, size_t>> reads;
+        std::vector<Instruction*> lengths;
+        std::unordered_set<BB*> deoptUses;
+    };
+
+    explicit EscapeAnalysis(Code* code);
+
+    const std::vector<Allocation>& nonEscaping() const { return nonEscaping_; }
+
+  private:
+    std::vector<Allocation> nonEscaping_;
+};
+
+} // namespace pir
+} // namespace rir
+
+#endif
@@ -0,0 +1,197 @@
+#include "index_range.h"
+#include "R/BuiltinIds.h"
+#include "R/r.h"
+#include "cfg.h"
+#include "compiler/pir/pir_impl.h"
+#include "compiler/util/visitor.h"
+
+#include <functional>
+#include <vector>
+
+namespace rir {
+namespace pir {
+
+namespace {
+
+// The body of a for loop. It is only entered if `1 <= counter <= length(seq)`.
+struct LoopBound {
+    BB* body;
+    Value* counter;
+    Value* seq;
+};
+
+bool nonNegative(Value* v, std::unordered_set<Phi*>& seen) {
+    v = v->followCasts();
+    if (auto ld = LdConst::Cast(v)) {
+        auto c = ld->c();
+        if (IS_SIMPLE_SCALAR(c, INTSXP))
+            return INTEGER(c)[0] != NA_INTEGER && INTEGER(c)[0] >= 0;
+        if (IS_SIMPLE_SCALAR(c, REALSXP))
+            return REAL(c)[0] >= 0;
+        return false;
+    }
+    if (auto inc = Inc::Cast(v))
+        return nonNegative(inc->arg(0).val(), seen);
+    if (auto phi = Phi::Cast(v)) {
+        // The property is a conjunction over all inputs, thus it is fine to
+        // assume it holds on cycles
+        if (!seen.insert(phi).second)
+            return true;
+        bool res = true;
+        phi->eachArg([&](BB*, Value* a) {
+            if (res && !nonNegative(a, seen))
+                res = false;
+        });
+        return res;
+    }
+    return false;
+}
+
+Value* builtinArg(Value* v, int id) {
+    if (auto b = CallSafeBuiltin::Cast(v)) {
+        if (b->builtinId == id && b->nCallArgs() == 1)
+            return b->callArg(0).val();
+    } else if (auto b = CallBuiltin::Cast(v)) {
+        if (b->builtinId == id && b->nCallArgs() == 1)
+            return b->callArg(0).val();
+    }
+    return nullptr;
+}
+
+// `x` for `seq_along(x)` and `seq_len(length(x))`
+Value* sequenceOf(Value* seq) {
+    seq = seq->followCastsAndForce();
+    auto x = builtinArg(seq, blt("seq_along"));
+    if (!x) {
+        if (auto n = builtinArg(seq, blt("seq_len"))) {
+            n = n->followCasts();
+            if (auto l = Length::Cast(n))
+                x = l->arg(0).val();
+            else
+                x = builtinArg(n, blt("length"));
+        }
+    }
+    // On objects length dispatches
+    if (!x || x->type.forced().maybeObj())
+        return nullptr;
+    return x->followCastsAndForce();
+}
+
+} // namespace
+
+IndexRangeAnalysis::IndexRangeAnalysis(Code* code) {
+    std::vector<LoopBound> bounds;
+
+    Visitor::run(code->entry, [&](BB* bb) {
+        if (bb->isEmpty())
+            return;
+        auto branch = Branch::Cast(bb->last());
+        if (!branch)
+            return;
+        // rir2pir emits `Branch(Identical(n < c, TRUE))` with the loop exit
+        // as the true branch
+        auto cond = branch->arg(0).val();
+        auto body = bb->falseBranch();
+        if (auto id = Identical::Cast(cond)) {
+            if (id->arg(1).val() == True::instance())
+                body = bb->falseBranch();
+            else if (id->arg(1).val() == False::instance())
+                body = bb->trueBranch();
+            else
+                return;
+            cond = id->arg(0).val();
+        }
+        auto lt = Lt::Cast(cond->followCasts());
+        if (!lt || !body->hasSinglePred())
+            return;
+        auto size = ForSeqSize::Cast(lt->arg(0).val()->followCasts());
+        if (!size)
+            return;
+        auto counter = Inc::Cast(lt->arg(1).val()->followCasts());
+        std::unordered_set<Phi*> seen;
+        if (!counter || !nonNegative(counter->arg(0).val(), seen))
+            return;
+        bounds.push_back({body, counter, size->arg(0).val()});
+    });
+    if (bounds.empty())
+        return;
+
+    DominanceGraph dom(code);
+
+    // All vectors `y` with `1 <= idx <= length(y)` at the position of `access`
+    std::function<std::unordered_set<Value*>(Value*, Instruction*)> bases =
+        [&](Value* idx, Instruction* access) {
+            std::unordered_set<Value*> res;
+            idx = idx->followCasts();
+            for (auto& b : bounds) {
+                if (b.counter != idx || !dom.dominates(b.body, access->bb()))
+                    continue;
+                res.insert(b.seq->followCastsAndForce());
+                if (auto x = sequenceOf(b.seq))
+                    res.insert(x);
+            }
+            // The loop variable of `for (i in seq_along(x))`
+            if (auto e = Extract2_1D::Cast(idx)) {
+                auto seq = e->vec()->followCastsAndForce();
+                if (auto x = sequenceOf(seq))
+                    if (bases(e->idx(), e).count(seq))
+                        res.insert(x);
+            }
+            return res;
+        };
+
+    // In bounds subassignments preserve the length. Like above the property is
+    // a conjunction and it is assumed to hold on cycles.
+    std::function<bool(Value*, Value*, std::unordered_set<Value*>&)>
+        sameLength = [&](Value* v, Value* x, std::unordered_set<Value*>& seen) {
+            v = v->followCastsAndForce();
+            if (v == x)
+                return true;
+            if (!Phi::Cast(v) && !Subassign1_1D::Cast(v) &&
+                !Subassign2_1D::Cast(v))
+                return false;
+            if (!seen.insert(v).second)
+                return true;
+            if (auto phi = Phi::Cast(v)) {
+                bool res = true;
+                phi->eachArg([&](BB*, Value* a) {
+                    if (res && !sameLength(a, x, seen))
+                        res = false;
+                });
+                return res;
+            }
+            auto sub = Instruction::Cast(v);
+            auto val = sub->arg(0).val();
+            auto vec = sub->arg(1).val();
+            auto idx = sub->arg(2).val();
+            // Assigning NULL deletes list elements, on objects `[<-`
+            // dispatches
+            if (val->type.maybe(RType::nil) || vec->type.forced().maybeObj())
+                return false;
+            return bases(idx, sub).count(x) && sameLength(vec, x, seen);
+        };
+
+    auto check = [&](Instruction* access, Value* vec, Value* idx) {
+        for (auto x : bases(idx, access)) {
+            std::unordered_set<Value*> seen;
+            if (sameLength(vec, x, seen)) {
+                inBounds_.insert(access);
+                return;
+            }
+        }
+    };
+
+    Visitor::run(code->entry, [&](Instruction* i) {
+        if (auto e = Extract1_1D::Cast(i))
+            check(i, e->vec(), e->idx());
+        else if (auto e = Extract2_1D::Cast(i))
+            check(i, e->vec(), e->idx());
+        else if (auto s = Subassign1_1D::Cast(i))
+            check(i, s->vec(), s->idx());
+        else if (auto s = Subassign2_1D::Cast(i))
+            check(i, s->vec(), s->idx());
+    });
+}
+
+} // namespace pir
+} // namespace rir
@@ -0,0 +1,37 @@
+#ifndef PIR_INDEX_RANGE_H
+#define PIR_INDEX_RANGE_H
+
+#include "compiler/pir/pir.h"
+
+#include <unordered_set>
+
+namespace rir {
+namespace pir {
+
+/*
+ * Finds vector accesses whose index is provably within the bounds of the
+ * vector and never NA, such that the backend can skip those checks.
+ *
+ * Indices are bounded by the counter of a `for` loop: in the loop body the
+ * counter `c` of `for (e in s)` satisfies `1 <= c <= length(s)`. If `s` is
+ * `seq_along(x)` or `seq_len(length(x))`, then the counter and the loop
+ * variable `e` are both valid indices into `x`. Vectors derived from `x` by in
+ * bounds subassignments have the same length and are covered as well.
+ */
+class IndexRangeAnalysis {
+  public:
+    explicit IndexRangeAnalysis(Code* code);
+
+    // For Extract1_1D, Extract2_1D, Subassign1_1D and Subassign2_1D
+    bool inBounds(Instruction* access) const {
+        return inBounds_.count(access);
+    }
+
+  private:
+    std::unordered_set<Instruction*> inBounds_;
+};
+
+} // namespace pir
+} // namespace rir
+
+#endif
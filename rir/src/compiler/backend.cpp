@@ -39,7 +39,7 @@ static void approximateRefcount(ClosureVersion* cls, Code* code,
 }
 
 static void approximateNeedsLdVarForUpdate(
-    Code* code, std::unordered_set<Instruction*>& needsLdVarForUpdate) {
+    Code* code, ArenaSet<Instruction*>& needsLdVarForUpdate) {
 
     auto apply = [&](Instruction* i, Value* vec_) {
         if (auto vec = Instruction::Cast(vec_)) {
@@ -373,7 +373,7 @@ rir::Function* Backend::doCompile(ClosureVersion* cls,
             return done.at(c);
         NeedsRefcountAdjustment refcount;
         approximateRefcount(cls, c, refcount, log);
-        std::unordered_set<Instruction*> needsLdVarForUpdate;
+        ArenaSet<Instruction*> needsLdVarForUpdate(tables);
         approximateNeedsLdVarForUpdate(c, needsLdVarForUpdate);
         auto res = done[c] = rir::Code::New(c->rirSrc()->src);
         // Can we do better?
@@ -393,6 +393,7 @@ rir::Function* Backend::doCompile(ClosureVersion* cls,
         return res;
     };
     auto body = compile(cls);
+    tables.rewind();
 
     if (MEASURE_COMPILER_BACKEND_PERF) {
         Measuring::countTimer("backend.cpp: pir2llvm");
@@ -432,6 +433,9 @@ int Parameter::DEOPT_CHAOS =
     getenv("PIR_DEOPT_CHAOS") ? atoi(getenv("PIR_DEOPT_CHAOS")) : 0;
 int Parameter::DEOPT_CHAOS_SEED =
     getenv("PIR_DEOPT_CHAOS_SEED") ? atoi(getenv("PIR_DEOPT_CHAOS_SEED")) : 42;
+size_t Parameter::ALLOCATOR_BUDGET =
+    getenv("PIR_ALLOCATOR_BUDGET") ? atoi(getenv("PIR_ALLOCATOR_BUDGET"))
+                                   : 5000000;
 
 } // namespace pir
 } // namespace rir
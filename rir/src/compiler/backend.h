@@ -6,6 +6,7 @@
 #include "compiler/native/pir_jit_llvm.h"
 #include "compiler/pir/module.h"
 #include "compiler/pir/pir.h"
+#include "compiler/util/arena.h"
 #include "runtime/Function.h"
 
 #include <sstream>
@@ -16,13 +17,20 @@ namespace pir {
 
 class Backend {
   public:
-    Backend(StreamLogger& logger, const std::string& name)
-        : jit(name), logger(logger) {}
+    Backend(StreamLogger& logger, const std::string& name,
+            bool background = false, bool tier1 = false)
+        : jit(name, background, tier1), logger(logger) {}
     Backend(const Backend&) = delete;
     Backend& operator=(const Backend&) = delete;
 
     rir::Function* getOrCompile(ClosureVersion* cls);
 
+    // Insert a compiled function into its dispatch table, as soon as the
+    // native code is ready.
+    void install(DispatchTable* table, rir::Function* fun) {
+        jit.install(table, fun);
+    }
+
   private:
     struct LastDestructor {
         ~LastDestructor();
@@ -32,6 +40,8 @@ class Backend {
     PirJitLLVM jit;
     std::unordered_map<ClosureVersion*, Function*> done;
     StreamLogger& logger;
+    // Side tables of the version being compiled
+    Arena tables;
 
     rir::Function* doCompile(ClosureVersion* cls, ClosureStreamLogger& log);
 };
@@ -0,0 +1,344 @@
+#include "compile_corpus.h"
+#include "R/Protect.h"
+#include "R/Serialize.h"
+#include "api.h"
+#include "compiler/parameter.h"
+#include "compiler/util/arena.h"
+#include "interpreter/interp_incl.h"
+#include "ir/BC_inc.h"
+#include "runtime/DispatchTable.h"
+
+#include <Rversion.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sstream>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace rir {
+namespace pir {
+
+namespace {
+
+static constexpr unsigned FORMAT_VERSION = 1;
+static const char* SUFFIX = ".rircorpus";
+
+// The first line of every entry. Entries of a different bytecode cannot be
+// deserialized and are skipped.
+const std::string& fingerprint() {
+    static std::string fp = [] {
+        std::stringstream s;
+        s << "rir-compile-corpus " << FORMAT_VERSION << " R " << R_MAJOR << "."
+          << R_MINOR << " bc " << (unsigned)Opcode::num_of << " ctx "
+          << sizeof(Context) << "\n";
+        return s.str();
+    }();
+    return fp;
+}
+
+bool replaying_ = false;
+
+struct PassStats {
+    std::string name;
+    size_t calls = 0;
+    double time = 0;
+    double heapGrowth = 0;
+};
+// In the order the passes first ran
+std::vector<PassStats> passes;
+std::unordered_map<std::string, size_t> passIndex;
+
+std::string fileName(const std::string& name) {
+    static size_t n = 0;
+    std::string base = name.substr(0, 64);
+    for (auto& c : base)
+        if (!isalnum(c) && c != '_' && c != '.')
+            c = '_';
+    if (base.empty())
+        base = "anon";
+    std::stringstream s;
+    s << base << "-" << getpid() << "-" << n++ << SUFFIX;
+    return s.str();
+}
+
+SEXP load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return nullptr;
+    char line[256];
+    if (!fgets(line, sizeof(line), file) || fingerprint() != line) {
+        fclose(file);
+        return nullptr;
+    }
+    auto oldPreserve = Parameter::RIR_PRESERVE;
+    Parameter::RIR_PRESERVE = true;
+    SEXP res = R_LoadFromFile(file, 0);
+    Parameter::RIR_PRESERVE = oldPreserve;
+    fclose(file);
+
+    if (TYPEOF(res) != VECSXP || XLENGTH(res) != 3 ||
+        !isValidClosureSEXP(VECTOR_ELT(res, 0)) ||
+        TYPEOF(VECTOR_ELT(res, 1)) != RAWSXP ||
+        XLENGTH(VECTOR_ELT(res, 1)) != sizeof(Context))
+        return nullptr;
+    return res;
+}
+
+std::vector<std::string> entries(const std::string& dir) {
+    std::vector<std::string> res;
+    auto d = opendir(dir.c_str());
+    if (!d)
+        return res;
+    auto suffix = strlen(SUFFIX);
+    while (auto e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() > suffix &&
+            name.compare(name.size() - suffix, suffix, SUFFIX) == 0)
+            res.push_back(name);
+    }
+    closedir(d);
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+} // namespace
+
+bool CompileCorpus::capturing() {
+    return Parameter::COMPILE_CORPUS && !replaying_;
+}
+
+void CompileCorpus::capture(SEXP closure, const Context& context,
+                            const std::string& name) {
+    auto path = std::string(Parameter::COMPILE_CORPUS) + "/" + fileName(name);
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return;
+
+    Protect p;
+    auto entry = p(Rf_allocVector(VECSXP, 3));
+    SET_VECTOR_ELT(entry, 0, closure);
+    auto ctx = Rf_allocVector(RAWSXP, sizeof(Context));
+    memcpy(RAW(ctx), &context, sizeof(Context));
+    SET_VECTOR_ELT(entry, 1, ctx);
+    SET_VECTOR_ELT(entry, 2, Rf_mkString(name.c_str()));
+
+    fputs(fingerprint().c_str(), file);
+    auto oldPreserve = Parameter::RIR_PRESERVE;
+    Parameter::RIR_PRESERVE = true;
+    R_SaveToFile(entry, file, 0);
+    Parameter::RIR_PRESERVE = oldPreserve;
+    fclose(file);
+}
+
+bool CompileCorpus::replaying() { return replaying_; }
+
+size_t CompileCorpus::heapBytes() {
+#if defined(__GLIBC__) &&                                                      \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+    return (unsigned)mallinfo().uordblks;
+#else
+    return 0;
+#endif
+}
+
+void CompileCorpus::passFinished(const std::string& pass, double time,
+                                 double heapGrowth) {
+    auto i = passIndex.find(pass);
+    if (i == passIndex.end()) {
+        i = passIndex.emplace(pass, passes.size()).first;
+        passes.push_back({pass});
+    }
+    auto& s = passes[i->second];
+    s.calls++;
+    s.time += time;
+    s.heapGrowth += heapGrowth;
+}
+
+SEXP CompileCorpus::replay(const std::string& dir, size_t repetitions) {
+    auto files = entries(dir);
+    passes.clear();
+    passIndex.clear();
+
+    struct Compilation {
+        std::string file;
+        std::string name;
+        std::string context;
+        size_t repetition;
+        bool compiled;
+        double time;
+        double heapGrowth;
+        size_t irObjects;
+        size_t mallocs;
+        double teardownTime;
+        Function::Stats stats;
+    };
+    std::vector<Compilation> compilations;
+    std::vector<std::string> warnings;
+
+    // Loading and compiling an entry run under R_ToplevelExec. An R error
+    // then only fails this entry, instead of jumping out of the replay with
+    // replaying_ still set. For the same reason warnings are only issued at
+    // the end.
+    struct Job {
+        std::string path;
+        SEXP entry;
+        SEXP closure;
+        Context context;
+        std::string name;
+    };
+    auto loadJob = [](void* data) {
+        auto job = static_cast<Job*>(data);
+        job->entry = load(job->path);
+        if (job->entry)
+            R_PreserveObject(job->entry);
+    };
+    auto compileJob = [](void* data) {
+        auto job = static_cast<Job*>(data);
+        ::pirCompile(job->closure, job->context, job->name, PirDebug);
+    };
+
+    replaying_ = true;
+    for (auto& f : files) {
+        for (size_t r = 0; r < repetitions; ++r) {
+            // A fresh copy each time, such that every repetition starts from
+            // an empty dispatch table
+            Job job;
+            job.path = dir + "/" + f;
+            job.entry = nullptr;
+            auto preserve = Parameter::RIR_PRESERVE;
+            auto loaded = R_ToplevelExec(loadJob, &job);
+            Parameter::RIR_PRESERVE = preserve;
+            if (!loaded || !job.entry) {
+                warnings.push_back("skipping corpus entry " + f);
+                break;
+            }
+            job.closure = VECTOR_ELT(job.entry, 0);
+            job.context = Context(RAW(VECTOR_ELT(job.entry, 1)));
+            job.name = CHAR(STRING_ELT(VECTOR_ELT(job.entry, 2), 0));
+            auto closure = job.closure;
+            auto& context = job.context;
+            auto& name = job.name;
+
+            auto heap = heapBytes();
+            auto arena = Arena::stats();
+            auto start = std::chrono::steady_clock::now();
+            if (!R_ToplevelExec(compileJob, &job))
+                warnings.push_back("compiling corpus entry " + f + " failed");
+            std::chrono::duration<double> time =
+                std::chrono::steady_clock::now() - start;
+
+            Compilation c;
+            c.file = f;
+            c.name = name;
+            std::stringstream ctx;
+            ctx << context;
+            c.context = ctx.str();
+            c.repetition = r;
+            c.compiled = false;
+            c.time = time.count();
+            c.heapGrowth = (double)heapBytes() - (double)heap;
+            c.irObjects = Arena::stats().objects - arena.objects;
+            c.mallocs = Arena::stats().mallocs - arena.mallocs;
+            c.teardownTime =
+                Arena::stats().teardownTime - arena.teardownTime;
+            // The table was loaded without optimized versions, thus all of
+            // them are from this compilation
+            auto table = DispatchTable::unpack(BODY(closure));
+            for (size_t i = table->size(); i > 1; --i) {
+                auto fun = table->get(i - 1);
+                if (!c.compiled || fun->context() == context) {
+                    c.compiled = true;
+                    c.stats = fun->stats;
+                }
+            }
+            compilations.push_back(c);
+            R_ReleaseObject(job.entry);
+        }
+    }
+    replaying_ = false;
+    for (auto& w : warnings)
+        Rf_warning("%s", w.c_str());
+
+    Protect p;
+    const char* names[] = {"compilations", "passes", ""};
+    auto res = p(Rf_mkNamed(VECSXP, names));
+
+    const char* cNames[] = {"file",         "name",       "context",
+                            "repetition",   "compiled",   "time",
+                            "pirTime",      "llvmTime",   "nativeBytes",
+                            "heapGrowth",   "irObjects",  "mallocs",
+                            "teardownTime", ""};
+    auto cs = p(Rf_mkNamed(VECSXP, cNames));
+    auto n = compilations.size();
+    auto file = p(Rf_allocVector(STRSXP, n));
+    auto name = p(Rf_allocVector(STRSXP, n));
+    auto context = p(Rf_allocVector(STRSXP, n));
+    auto repetition = p(Rf_allocVector(INTSXP, n));
+    auto compiled = p(Rf_allocVector(LGLSXP, n));
+    std::vector<SEXP> reals;
+    for (size_t i = 0; i < 8; ++i)
+        reals.push_back(p(Rf_allocVector(REALSXP, n)));
+    for (size_t i = 0; i < n; ++i) {
+        auto& c = compilations[i];
+        SET_STRING_ELT(file, i, Rf_mkChar(c.file.c_str()));
+        SET_STRING_ELT(name, i, Rf_mkChar(c.name.c_str()));
+        SET_STRING_ELT(context, i, Rf_mkChar(c.context.c_str()));
+        INTEGER(repetition)[i] = c.repetition + 1;
+        LOGICAL(compiled)[i] = c.compiled;
+        REAL(reals[0])[i] = c.time;
+        REAL(reals[1])[i] = c.stats.pirTime;
+        REAL(reals[2])[i] = c.stats.llvmTime;
+        REAL(reals[3])[i] = c.stats.nativeBytes;
+        REAL(reals[4])[i] = c.heapGrowth;
+        REAL(reals[5])[i] = c.irObjects;
+        REAL(reals[6])[i] = c.mallocs;
+        REAL(reals[7])[i] = c.teardownTime;
+    }
+    SET_VECTOR_ELT(cs, 0, file);
+    SET_VECTOR_ELT(cs, 1, name);
+    SET_VECTOR_ELT(cs, 2, context);
+    SET_VECTOR_ELT(cs, 3, repetition);
+    SET_VECTOR_ELT(cs, 4, compiled);
+    for (size_t i = 0; i < reals.size(); ++i)
+        SET_VECTOR_ELT(cs, 5 + i, reals[i]);
+    SET_VECTOR_ELT(res, 0, cs);
+
+    const char* pNames[] = {"pass", "calls", "time", "heapGrowth", ""};
+    auto ps = p(Rf_mkNamed(VECSXP, pNames));
+    auto pass = p(Rf_allocVector(STRSXP, passes.size()));
+    auto calls = p(Rf_allocVector(REALSXP, passes.size()));
+    auto time = p(Rf_allocVector(REALSXP, passes.size()));
+    auto heap = p(Rf_allocVector(REALSXP, passes.size()));
+    for (size_t i = 0; i < passes.size(); ++i) {
+        SET_STRING_ELT(pass, i, Rf_mkChar(passes[i].name.c_str()));
+        REAL(calls)[i] = passes[i].calls;
+        REAL(time)[i] = passes[i].time;
+        REAL(heap)[i] = passes[i].heapGrowth;
+    }
+    SET_VECTOR_ELT(ps, 0, pass);
+    SET_VECTOR_ELT(ps, 1, calls);
+    SET_VECTOR_ELT(ps, 2, time);
+    SET_VECTOR_ELT(ps, 3, heap);
+    SET_VECTOR_ELT(res, 1, ps);
+    return res;
+}
+
+const char* Parameter::COMPILE_CORPUS =
+    getenv("PIR_COMPILE_CORPUS") && *getenv("PIR_COMPILE_CORPUS")
+        ? getenv("PIR_COMPILE_CORPUS")
+        : nullptr;
+
+} // namespace pir
+} // namespace rir
@@ -0,0 +1,43 @@
+#ifndef RIR_COMPILER_COMPILE_CORPUS_H
+#define RIR_COMPILER_COMPILE_CORPUS_H
+
+#include "R/r.h"
+#include "runtime/Context.h"
+
+#include <string>
+
+namespace rir {
+namespace pir {
+
+// Compile-replay corpus, captured with PIR_COMPILE_CORPUS=<dir>.
+//
+// Every closure PIR is asked to optimize is written to the corpus before it is
+// compiled: the closure with its dispatch table, serialized with
+// RIR_PRESERVE such that the bytecode keeps the type feedback of the baseline
+// version, and the context it is optimized for. Replaying the corpus reruns
+// rir2pir, the optimization passes, the backend and LLVM on exactly the same
+// inputs, without the programs which produced them. This measures compiler
+// throughput on its own.
+class CompileCorpus {
+  public:
+    static bool capturing();
+    static void capture(SEXP closure, const Context& context,
+                        const std::string& name);
+
+    // Compiles every entry in dir repetitions times. Returns a list with a
+    // table of the compilations and a table of the optimization passes.
+    static SEXP replay(const std::string& dir, size_t repetitions);
+
+    // Per pass measurements, only taken while replaying. The heap is the
+    // malloc heap in use, thus its growth is what a pass allocated and did
+    // not free again.
+    static bool replaying();
+    static size_t heapBytes();
+    static void passFinished(const std::string& pass, double time,
+                             double heapGrowth);
+};
+
+} // namespace pir
+} // namespace rir
+
+#endif
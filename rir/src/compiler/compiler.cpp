@@ -7,6 +7,7 @@
 
 #include "compiler/analysis/query.h"
 #include "compiler/analysis/verifier.h"
+#include "compiler/compile_corpus.h"
 #include "compiler/opt/pass_definitions.h"
 #include "compiler/opt/pass_scheduler.h"
 #include "compiler/parameter.h"
@@ -88,18 +89,20 @@ void Compiler::compileClosure(Closure* closure, rir::Function* optFunction,
         }
     }
 
-    // Currently dots args are not supported in PIR. Unless if we statically
-    // matched all arguments correctly and are therefore guaranteed to receive a
-    // `...` list as DOTSXP in the correct location, we can support them.
-    // TODO: extend call instruction to do the necessary argument shuffling to
-    // support it in all cases
+    // Dots args are only supported if we statically matched all arguments
+    // correctly and are therefore guaranteed to receive a `...` list as DOTSXP
+    // in the correct location. PIR callers create the DotsList, the
+    // interpreter packs the surplus arguments of positional calls (see
+    // rirCallPackingDots). Calls with named arguments still need GNU R's
+    // argument matching.
     if (!ctx.includes(Assumption::StaticallyArgmatched) &&
         closure->formals().hasDots()) {
         logger.warn("no support for ...");
         return fail();
     }
 
-    if (closure->rirFunction()->body()->codeSize > Parameter::MAX_INPUT_SIZE) {
+    if (closure->rirFunction()->body()->inputSize() >
+        Parameter::MAX_INPUT_SIZE) {
         closure->rirFunction()->flags.set(Function::NotOptimizable);
         logger.warn("skipping huge function");
         return fail();
@@ -206,6 +209,76 @@ void Compiler::compileClosure(Closure* closure, rir::Function* optFunction,
     return fail();
 }
 
+// The outermost loop around pc with at most MAX_INPUT_SIZE bytes of bytecode.
+// Loops are found by their back-edge, a jump from the end of the loop body to
+// the loop header.
+static bool findLoopRegion(rir::Code* code, Opcode* pc, Opcode*& begin,
+                           Opcode*& end) {
+    begin = end = nullptr;
+    for (auto pos = code->code(); pos != code->endCode(); pos = BC::next(pos)) {
+        BC bc = BC::decodeShallow(pos);
+        if (!bc.isJmp())
+            continue;
+        auto header = bc.jmpTarget(pos);
+        auto exit = BC::next(pos);
+        if (header > pos || header > pc || exit <= pc ||
+            code->inputSize(header, exit) > Parameter::MAX_INPUT_SIZE)
+            continue;
+        if (!begin || exit - header > end - begin) {
+            begin = header;
+            end = exit;
+        }
+    }
+    return begin != nullptr;
+}
+
+void Compiler::compileContinuation(SEXP closure, const std::string& name,
+                                   Opcode* pc,
+                                   const std::vector<PirType>& stack,
+                                   MaybeCls success, Maybe fail) {
+    assert(isValidClosureSEXP(closure));
+
+    DispatchTable* tbl = DispatchTable::unpack(BODY(closure));
+    auto fun = tbl->baseline();
+
+    // Of huge functions only the hot loop around pc is compiled
+    Opcode* regionBegin = nullptr;
+    Opcode* regionEnd = nullptr;
+    if (fun->body()->inputSize() > Parameter::MAX_INPUT_SIZE &&
+        (!Parameter::PIR_REGIONS ||
+         !findLoopRegion(fun->body(), pc, regionBegin, regionEnd))) {
+        logger.warn("skipping huge function");
+        return fail();
+    }
+
+    auto continuation = module->declareContinuation(name, closure, fun,
+                                                    tbl->userDefinedContext());
+    auto version = continuation->declareVersion(defaultContext, true, fun);
+    Builder builder(version);
+    auto& log = logger.begin(version);
+    Rir2Pir rir2pir(*this, version, log, continuation->name(), {});
+
+    if (rir2pir.tryCompileContinuation(builder, pc, stack, regionBegin,
+                                       regionEnd)) {
+        log.compilationEarlyPir(version);
+#ifdef FULLVERIFIER
+        Verify::apply(version, "Error after initial translation", true);
+#else
+#ifndef NDEBUG
+        Verify::apply(version, "Error after initial translation");
+#endif
+#endif
+        log.flush();
+        return success(version);
+    }
+
+    log.failed("rir2pir aborted");
+    log.flush();
+    logger.close(version);
+    continuation->erase(defaultContext);
+    return fail();
+}
+
 bool MEASURE_COMPILER_PERF = getenv("PIR_MEASURE_COMPILER") ? true : false;
 
 static void findUnreachable(Module* m) {
@@ -292,12 +365,27 @@ void Compiler::optimizeModule() {
                 if (MEASURE_COMPILER_PERF)
                     Measuring::startTimer("compiler.cpp: " +
                                           translation->getName());
+                auto replaying = CompileCorpus::replaying();
+                std::chrono::steady_clock::time_point start;
+                size_t heap = 0;
+                if (replaying) {
+                    start = std::chrono::steady_clock::now();
+                    heap = CompileCorpus::heapBytes();
+                }
 
                 if (translation->apply(*this, v, log.out()))
                     changed = true;
+                tables_.rewind();
                 if (MEASURE_COMPILER_PERF)
                     Measuring::countTimer("compiler.cpp: " +
                                           translation->getName());
+                if (replaying) {
+                    std::chrono::duration<double> time =
+                        std::chrono::steady_clock::now() - start;
+                    CompileCorpus::passFinished(
+                        translation->getName(), time.count(),
+                        (double)CompileCorpus::heapBytes() - (double)heap);
+                }
 
                 log.pirOptimizations(translation);
                 log.flush();
@@ -3,7 +3,9 @@
 
 #include "R/Preserve.h"
 #include "log/stream_logger.h"
+#include "util/arena.h"
 #include "pir/pir.h"
+#include "pir/type.h"
 #include "utils/FormalArgs.h"
 
 #include <list>
@@ -36,15 +38,24 @@ class Compiler {
                          SEXP formals, SEXP srcRef, const Context& ctx,
                          MaybeCls success, Maybe fail,
                          std::list<PirTypeFeedback*> outerFeedback);
+    // On-stack replacement and deoptless: compile the rest of the body of
+    // closure, starting at pc, with values of the given types on the stack.
+    void compileContinuation(SEXP closure, const std::string& name,
+                             Opcode* pc, const std::vector<PirType>& stack,
+                             MaybeCls success, Maybe fail);
     void optimizeModule();
 
     bool seenC = false;
 
     void preserve(SEXP c) { preserve_(c); }
 
+    // For the side tables of the running pass
+    Arena& tables() { return tables_; }
+
   private:
     Module* module;
     StreamLogger& logger;
+    Arena tables_;
 
     void compileClosure(Closure* closure, rir::Function* optFunction,
                         const Context& ctx, bool root, MaybeCls success,
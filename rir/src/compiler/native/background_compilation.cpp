@@ -0,0 +1,176 @@
+#include "background_compilation.h"
+#include "compiler/parameter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace rir {
+namespace pir {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Entry {
+    BackgroundCompilation::Job job;
+    Clock::time_point submitted;
+};
+
+struct Queue {
+    // Guards todo, done and the worker side stats
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<Entry> todo;
+    std::deque<Entry> done;
+    std::atomic<size_t> finished{0};
+    bool stop = false;
+    double compileTime = 0;
+
+    std::thread worker;
+
+    // Only accessed from the main thread
+    std::unordered_set<DispatchTable*> inFlight;
+    size_t submitted = 0;
+    size_t installed = 0;
+    size_t maxQueueDepth = 0;
+    double totalInstallLatency = 0;
+    double maxInstallLatency = 0;
+
+    void start() {
+        if (worker.joinable())
+            return;
+        worker = std::thread([this]() { run(); });
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wakeup.wait(lock, [&]() { return stop || !todo.empty(); });
+            if (stop)
+                return;
+            auto e = std::move(todo.front());
+            todo.pop_front();
+            lock.unlock();
+
+            auto start = Clock::now();
+            e.job.compile();
+            std::chrono::duration<double> duration = Clock::now() - start;
+
+            lock.lock();
+            compileTime += duration.count();
+            done.push_back(std::move(e));
+            finished++;
+            wakeup.notify_all();
+        }
+    }
+};
+
+// Never destroyed, the worker might still reference it during exit
+Queue& queue() {
+    static Queue* q = new Queue;
+    return *q;
+}
+
+} // namespace
+
+bool BackgroundCompilation::enabled() { return Parameter::BACKGROUND_COMPILE; }
+
+void BackgroundCompilation::submit(Job&& job) {
+    auto& q = queue();
+    for (auto p : job.preserve)
+        R_PreserveObject(p);
+    if (job.table)
+        q.inFlight.insert(job.table);
+    q.submitted++;
+    q.start();
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.todo.push_back({std::move(job), Clock::now()});
+        q.maxQueueDepth = std::max(q.maxQueueDepth, q.submitted - q.installed);
+    }
+    q.wakeup.notify_all();
+}
+
+bool BackgroundCompilation::inFlight(DispatchTable* table) {
+    if (!enabled())
+        return false;
+    return queue().inFlight.count(table);
+}
+
+void BackgroundCompilation::installFinished() {
+    auto& q = queue();
+    if (q.finished.load(std::memory_order_relaxed) == 0)
+        return;
+
+    std::deque<Entry> ready;
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        std::swap(ready, q.done);
+        q.finished -= ready.size();
+    }
+
+    auto now = Clock::now();
+    for (auto& e : ready) {
+        e.job.install();
+        for (auto p : e.job.preserve)
+            R_ReleaseObject(p);
+        if (e.job.table)
+            q.inFlight.erase(e.job.table);
+
+        std::chrono::duration<double> latency = now - e.submitted;
+        q.installed++;
+        q.totalInstallLatency += latency.count();
+        q.maxInstallLatency = std::max(q.maxInstallLatency, latency.count());
+    }
+}
+
+void BackgroundCompilation::drain() {
+    auto& q = queue();
+    {
+        std::unique_lock<std::mutex> lock(q.mutex);
+        q.wakeup.wait(lock, [&]() {
+            return q.stop || q.submitted == q.installed + q.done.size();
+        });
+    }
+    installFinished();
+}
+
+void BackgroundCompilation::shutdown() {
+    auto& q = queue();
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.stop = true;
+    }
+    q.wakeup.notify_all();
+    if (q.worker.joinable())
+        q.worker.join();
+}
+
+BackgroundCompilation::Stats BackgroundCompilation::stats() {
+    auto& q = queue();
+    std::lock_guard<std::mutex> lock(q.mutex);
+    Stats s;
+    s.submitted = q.submitted;
+    s.installed = q.installed;
+    s.queueDepth = q.submitted - q.installed;
+    s.maxQueueDepth = q.maxQueueDepth;
+    s.compileTime = q.compileTime;
+    s.totalInstallLatency = q.totalInstallLatency;
+    s.maxInstallLatency = q.maxInstallLatency;
+    return s;
+}
+
+bool Parameter::BACKGROUND_COMPILE =
+    getenv("PIR_BACKGROUND_COMPILE") &&
+    0 == strncmp("1", getenv("PIR_BACKGROUND_COMPILE"), 1);
+
+} // namespace pir
+} // namespace rir
@@ -0,0 +1,68 @@
+#ifndef RIR_COMPILER_BACKGROUND_COMPILATION_H
+#define RIR_COMPILER_BACKGROUND_COMPILATION_H
+
+#include "R/r.h"
+
+#include <functional>
+#include <vector>
+
+namespace rir {
+
+struct DispatchTable;
+
+namespace pir {
+
+// Asynchronous tiering. The PIR pipeline needs the R heap and thus runs on the
+// main thread. The expensive part, LLVM optimization and code generation, is
+// independent of R and runs on a worker thread. The interpreter keeps
+// executing the current version in the meantime. Once the worker is done, the
+// new version is installed into the dispatch table at the next safepoint
+// (call entry in the interpreter).
+class BackgroundCompilation {
+  public:
+    struct Job {
+        // Runs on the worker thread. Must not touch the R heap.
+        std::function<void()> compile;
+        // Runs on the main thread at a safepoint, after compile finished.
+        std::function<void()> install;
+        // The table the compiled version will be inserted into
+        DispatchTable* table = nullptr;
+        // Kept alive until the job is installed
+        std::vector<SEXP> preserve;
+    };
+
+    struct Stats {
+        size_t submitted;
+        size_t installed;
+        size_t queueDepth;
+        size_t maxQueueDepth;
+        double compileTime;
+        double totalInstallLatency;
+        double maxInstallLatency;
+    };
+
+    static bool enabled();
+
+    static void submit(Job&& job);
+
+    // Is there a compilation in flight for this dispatch table?
+    static bool inFlight(DispatchTable* table);
+
+    // Install all finished jobs. Must be called from the main thread at a
+    // point where inserting into dispatch tables is safe. Cheap if nothing is
+    // ready.
+    static void installFinished();
+
+    // Blocks until all submitted jobs are finished and installs them.
+    static void drain();
+
+    // Stops the worker thread. Pending jobs are dropped.
+    static void shutdown();
+
+    static Stats stats();
+};
+
+} // namespace pir
+} // namespace rir
+
+#endif
@@ -2,10 +2,12 @@
 
 #include "compiler/native/types_llvm.h"
 #include "compiler/parameter.h"
+#include "compiler/pir/type.h"
 #include "interpreter/cache.h"
 #include "interpreter/call_context.h"
 #include "interpreter/interp.h"
 #include "ir/Deoptimization.h"
+#include "runtime/JitStats.h"
 #include "runtime/LazyArglist.h"
 #include "runtime/LazyEnvironment.h"
 #include "utils/Pool.h"
@@ -16,6 +18,12 @@
 
 #include "llvm/IR/Attributes.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <unordered_map>
+#include <vector>
+
 namespace rir {
 namespace pir {
 
@@ -111,14 +119,14 @@ SEXP ldvarForUpdateImpl(SEXP sym, SEXP env) {
 }
 
 SEXP ldvarImpl(SEXP a, SEXP b) {
-    auto res = Rf_findVar(a, b);
+    auto res = GlobalCells::findVar(a, b);
     // std::cout << CHAR(PRINTNAME(a)) << "=";
     // Rf_PrintValue(res);
     ENSURE_NAMED(res);
     return res;
 }
 
-SEXP ldvarGlobalImpl(SEXP a) { return Rf_findVar(a, R_GlobalEnv); }
+SEXP ldvarGlobalImpl(SEXP a) { return GlobalCells::findVar(a, R_GlobalEnv); }
 
 SEXP ldvarCachedImpl(SEXP sym, SEXP env, SEXP* cache) {
     if (*cache != (SEXP)NativeBuiltins::bindingsCacheFails) {
@@ -133,7 +141,7 @@ SEXP ldvarCachedImpl(SEXP sym, SEXP env, SEXP* cache) {
             }
         }
     }
-    auto res = Rf_findVar(sym, env);
+    auto res = GlobalCells::findVar(sym, env);
     ENSURE_NAMED(res);
     return res;
 }
@@ -227,7 +235,7 @@ SEXP chkfunImpl(SEXP sym, SEXP res) {
 }
 
 SEXP ldfunImpl(SEXP sym, SEXP env) {
-    SEXP res = Rf_findFun(sym, env);
+    SEXP res = GlobalCells::findFun(sym, env);
 
     // TODO something should happen here
     if (res == R_UnboundValue)
@@ -773,7 +781,112 @@ int asLogicalImpl(SEXP a) {
 
 int lengthImpl(SEXP e) { return Rf_length(e); }
 
-void deoptImpl(Code* c, SEXP cls, DeoptMetadata* m, R_bcstack_t* args) {
+// Deoptless: continuations compiled for one deopt site, together with the
+// types of the frame's stack values they were compiled for. A failed
+// compilation is cached with a null fun. A continuation is the value of a weak
+// reference keyed by the dispatch table of its closure, thus it is collected
+// together with the closure.
+struct DeoptlessContinuation {
+    std::vector<pir::PirType> stack;
+    Function* fun;
+    SEXP ref;
+};
+static std::unordered_map<DeoptMetadata*, std::vector<DeoptlessContinuation>>
+    deoptlessContinuations;
+
+// Finalizer of the weak reference, the closure is gone
+static void dropDeoptlessContinuation(SEXP ref) {
+    for (auto i = deoptlessContinuations.begin();
+         i != deoptlessContinuations.end();) {
+        auto& cache = i->second;
+        cache.erase(std::remove_if(cache.begin(), cache.end(),
+                                   [&](auto& e) { return e.ref == ref; }),
+                    cache.end());
+        if (cache.empty())
+            i = deoptlessContinuations.erase(i);
+        else
+            ++i;
+    }
+    R_ReleaseObject(ref);
+}
+
+static bool deoptlessPossible(Code* c, SEXP cls, DeoptMetadata* m) {
+    if (!pir::Parameter::DEOPTLESS || !cls || m->numFrames != 1 ||
+        m->frames[0].inPromise)
+        return false;
+    // Only from the body of an optimized version (not a promise or an OSR
+    // continuation) into its baseline. Thus we can return the result of the
+    // continuation from here.
+    auto dt = DispatchTable::unpack(BODY(cls));
+    if (m->frames[0].code != dt->baseline()->body())
+        return false;
+    for (size_t i = 1; i < dt->size(); ++i)
+        if (dt->get(i)->body() == c)
+            return true;
+    return false;
+}
+
+// Instead of continuing in the interpreter, continue in native code compiled
+// for the current frame state. Returns nullptr if there is no continuation.
+static SEXP deoptless(SEXP cls, DeoptMetadata* m, SEXP env) {
+    auto& frame = m->frames[0];
+    auto stack = ostack_cell_at(ctx, frame.stackSize);
+
+    std::vector<pir::PirType> types;
+    for (size_t i = 0; i < frame.stackSize; ++i) {
+        auto v = stack[i].u.sxpval;
+        types.push_back(TYPEOF(v) == PROMSXP ? pir::PirType::any()
+                                             : pir::PirType(v));
+    }
+
+    auto& cache = deoptlessContinuations[m];
+    Function* fun = nullptr;
+    auto hit = std::find_if(cache.begin(), cache.end(), [&](auto& e) {
+        for (size_t i = 0; i < types.size(); ++i)
+            if (!types[i].isA(e.stack[i]))
+                return false;
+        return true;
+    });
+    if (hit != cache.end()) {
+        fun = hit->fun;
+    } else if (cache.size() < pir::Parameter::DEOPTLESS_MAX_CONTINUATIONS) {
+        fun = globalContext()->continuationCompiler(
+            cls, frame.pc, stack, frame.stackSize, R_NilValue);
+        SEXP ref = R_NilValue;
+        if (fun) {
+            PROTECT(fun->container());
+            ref = R_MakeWeakRefC(BODY(cls), fun->container(),
+                                 dropDeoptlessContinuation, FALSE);
+            R_PreserveObject(ref);
+            UNPROTECT(1);
+        }
+        cache.push_back({types, fun, ref});
+    }
+    if (!fun)
+        return nullptr;
+
+    // The continuation runs in the function environment
+    if (auto le = LazyEnvironment::check(env)) {
+        if (le->materialized()) {
+            env = le->materialized();
+        } else {
+            auto cntxt = findFunctionContextFor(env);
+            if (!cntxt)
+                return nullptr;
+            env = materialize(env);
+            cntxt->cloenv = env;
+        }
+    }
+    if (TYPEOF(env) != ENVSXP)
+        return nullptr;
+
+    auto code = fun->body();
+    return code->nativeCode(code, stack, env, cls);
+}
+
+static SEXP deoptImpl_(Code* c, SEXP cls, DeoptMetadata* m, R_bcstack_t* args,
+                       bool allowDeoptless) {
+    bool tryDeoptless = allowDeoptless && deoptlessPossible(c, cls, m);
     if (!pir::Parameter::DEOPT_CHAOS) {
         if (cls) {
             // TODO: this version is still reachable from static call inline
@@ -800,8 +913,14 @@ void deoptImpl(Code* c, SEXP cls, DeoptMetadata* m, R_bcstack_t* args) {
     }
 
     c->registerDeopt();
+    if (cls)
+        JitStats::registerDeopt(cls);
     SEXP env =
         ostack_at(ctx, stackHeight - m->frames[m->numFrames - 1].stackSize - 1);
+    if (tryDeoptless)
+        if (auto res = deoptless(cls, m, env))
+            return res;
+
     CallContext call(ArglistOrder::NOT_REORDERED, c, cls,
                      /* nargs */ -1, src_pool_at(globalContext(), c->src), args,
                      (Immediate*)nullptr, env, Context(), globalContext());
@@ -810,6 +929,18 @@ void deoptImpl(Code* c, SEXP cls, DeoptMetadata* m, R_bcstack_t* args) {
                            m->numFrames - 1, stackHeight,
                            (RCNTXT*)R_GlobalContext);
     assert(false);
+    return nullptr;
+}
+
+SEXP deoptImpl(Code* c, SEXP cls, DeoptMetadata* m, R_bcstack_t* args) {
+    return deoptImpl_(c, cls, m, args, true);
+}
+
+// The unboxed entry of a version cannot return the result of a deoptless
+// continuation, thus this one never returns
+void deoptUnboxedImpl(Code* c, SEXP cls, DeoptMetadata* m, R_bcstack_t* args) {
+    deoptImpl_(c, cls, m, args, false);
+    assert(false);
 }
 
 void assertFailImpl(const char* msg) {
@@ -1924,37 +2055,280 @@ SEXP makeVectorImpl(int mode, size_t len) {
     return s;
 }
 
+// The reductions below return the same results as do_summary, do_logic3 and
+// do_which in GNU R. Sums, products and means of doubles accumulate in long
+// double (LDOUBLE in GNU R), which is not associative, thus those loops stay
+// sequential. The others are exact in any order. They keep one accumulator per
+// lane without dependencies between consecutive iterations, such that the
+// loops are vectorized.
+static constexpr R_xlen_t REDUCE_LANES = 4;
+// Elements per block of the reductions which can stop early
+static constexpr R_xlen_t REDUCE_BLOCK = 256;
+// Up to this length the int64 sum of ints cannot overflow
+static constexpr R_xlen_t REDUCE_EXACT_INT_SUM = (R_xlen_t)1 << 31;
+
+static const int* intOrLgl(SEXP v) {
+    assert(TYPEOF(v) == INTSXP || TYPEOF(v) == LGLSXP);
+    return TYPEOF(v) == INTSXP ? INTEGER(v) : LOGICAL(v);
+}
+
+// Exact sum of the ints in x, false if there is an NA
+static bool sumInts(const int* x, R_xlen_t len, int64_t& res) {
+    assert(len <= REDUCE_EXACT_INT_SUM);
+    int64_t acc[REDUCE_LANES] = {};
+    int na[REDUCE_LANES] = {};
+    R_xlen_t i = 0;
+    for (; i + REDUCE_LANES <= len; i += REDUCE_LANES) {
+        for (R_xlen_t l = 0; l < REDUCE_LANES; ++l) {
+            acc[l] += x[i + l];
+            na[l] |= x[i + l] == NA_INTEGER;
+        }
+    }
+    for (; i < len; ++i) {
+        acc[0] += x[i];
+        na[0] |= x[i] == NA_INTEGER;
+    }
+    res = 0;
+    for (R_xlen_t l = 0; l < REDUCE_LANES; ++l) {
+        if (na[l])
+            return false;
+        res += acc[l];
+    }
+    return true;
+}
+
 double prodrImpl(SEXP v) {
-    double res = 1;
+    long double res = 1;
     auto len = XLENGTH(v);
     if (TYPEOF(v) == REALSXP) {
+        auto x = REAL(v);
+        for (R_xlen_t i = 0; i < len; ++i)
+            res *= x[i];
+    } else {
+        auto x = intOrLgl(v);
         for (R_xlen_t i = 0; i < len; ++i) {
-            res *= REAL(v)[i];
-        }
-    } else if (TYPEOF(v) == INTSXP) {
-        for (R_xlen_t i = 0; i < len; ++i) {
-            res *= INTEGER(v)[i];
+            if (x[i] == NA_INTEGER)
+                return NA_REAL;
+            res *= x[i];
         }
-    } else {
-        assert(false);
     }
-    return res;
+    if (res > DBL_MAX)
+        return R_PosInf;
+    if (res < -DBL_MAX)
+        return R_NegInf;
+    return (double)res;
+}
+
+int sumiImpl(SEXP v) {
+    auto x = intOrLgl(v);
+    auto len = XLENGTH(v);
+    int64_t res = 0;
+    // On long vectors GNU R checks the int64 sum against +-9e15, we do so
+    // after every chunk
+    for (R_xlen_t i = 0; i < len; i += REDUCE_EXACT_INT_SUM) {
+        int64_t chunk;
+        if (!sumInts(x + i, std::min(len - i, REDUCE_EXACT_INT_SUM), chunk))
+            return NA_INTEGER;
+        res += chunk;
+        if (res > 9000000000000000L || res < -9000000000000000L)
+            break;
+    }
+    if (res > INT_MAX || res < -INT_MAX) {
+        Rf_warning("integer overflow - use sum(as.numeric(.))");
+        return NA_INTEGER;
+    }
+    return (int)res;
 }
 
 double sumrImpl(SEXP v) {
-    double res = 0;
+    if (TYPEOF(v) != REALSXP) {
+        auto res = sumiImpl(v);
+        return res == NA_INTEGER ? NA_REAL : res;
+    }
+    long double res = 0;
+    auto x = REAL(v);
+    auto len = XLENGTH(v);
+    for (R_xlen_t i = 0; i < len; ++i)
+        res += x[i];
+    if (res > DBL_MAX)
+        return R_PosInf;
+    if (res < -DBL_MAX)
+        return R_NegInf;
+    return (double)res;
+}
+
+double meanImpl(SEXP v) {
     auto len = XLENGTH(v);
     if (TYPEOF(v) == REALSXP) {
-        for (R_xlen_t i = 0; i < len; ++i) {
-            res += REAL(v)[i];
+        auto x = REAL(v);
+        long double s = 0;
+        for (R_xlen_t i = 0; i < len; ++i)
+            s += x[i];
+        s /= len;
+        if (R_FINITE((double)s)) {
+            long double t = 0;
+            for (R_xlen_t i = 0; i < len; ++i)
+                t += x[i] - s;
+            s += t / len;
         }
-    } else if (TYPEOF(v) == INTSXP) {
+        return (double)s;
+    }
+    auto x = intOrLgl(v);
+    long double s = 0;
+    if (len <= REDUCE_EXACT_INT_SUM) {
+        // The long double sum of fewer ints is exact as well
+        int64_t sum;
+        if (!sumInts(x, len, sum))
+            return NA_REAL;
+        s = sum;
+    } else {
         for (R_xlen_t i = 0; i < len; ++i) {
-            res += INTEGER(v)[i];
+            if (x[i] == NA_INTEGER)
+                return NA_REAL;
+            s += x[i];
         }
-    } else {
-        assert(false);
     }
+    return (double)(s / len);
+}
+
+double minmaxrImpl(SEXP v, int isMax) {
+    assert(TYPEOF(v) == REALSXP);
+    auto x = REAL(v);
+    auto len = XLENGTH(v);
+    if (len == 0) {
+        if (isMax)
+            Rf_warning("no non-missing arguments to max; returning -Inf");
+        else
+            Rf_warning("no non-missing arguments to min; returning Inf");
+        return isMax ? R_NegInf : R_PosInf;
+    }
+
+    double acc[REDUCE_LANES];
+    int nan[REDUCE_LANES] = {};
+    for (R_xlen_t l = 0; l < REDUCE_LANES; ++l)
+        acc[l] = x[0];
+    R_xlen_t i = 0;
+    for (; i + REDUCE_LANES <= len; i += REDUCE_LANES) {
+        for (R_xlen_t l = 0; l < REDUCE_LANES; ++l) {
+            auto e = x[i + l];
+            nan[l] |= e != e;
+            acc[l] = (isMax ? e > acc[l] : e < acc[l]) ? e : acc[l];
+        }
+    }
+    for (; i < len; ++i) {
+        nan[0] |= x[i] != x[i];
+        acc[0] = (isMax ? x[i] > acc[0] : x[i] < acc[0]) ? x[i] : acc[0];
+    }
+    auto res = acc[0];
+    bool anyNaN = false;
+    for (R_xlen_t l = 0; l < REDUCE_LANES; ++l) {
+        anyNaN = anyNaN || nan[l];
+        res = (isMax ? acc[l] > res : acc[l] < res) ? acc[l] : res;
+    }
+
+    if (anyNaN) {
+        // As rmin and rmax: the first NA, or else the last NaN
+        double s = 0;
+        for (i = 0; i < len; ++i)
+            if (ISNAN(x[i]) && !ISNA(s))
+                s = x[i];
+        return s;
+    }
+    // The first of equal elements is returned, which only matters for zeros
+    if (res == 0)
+        for (i = 0; i < len; ++i)
+            if (x[i] == 0)
+                return x[i];
+    return res;
+}
+
+SEXP minmaxiImpl(SEXP v, int isMax) {
+    assert(TYPEOF(v) == INTSXP);
+    auto x = INTEGER(v);
+    auto len = XLENGTH(v);
+    if (len == 0) {
+        if (isMax)
+            Rf_warning("no non-missing arguments to max; returning -Inf");
+        else
+            Rf_warning("no non-missing arguments to min; returning Inf");
+        return Rf_ScalarReal(isMax ? R_NegInf : R_PosInf);
+    }
+
+    int acc[REDUCE_LANES];
+    int na[REDUCE_LANES] = {};
+    for (R_xlen_t l = 0; l < REDUCE_LANES; ++l)
+        acc[l] = x[0];
+    R_xlen_t i = 0;
+    for (; i + REDUCE_LANES <= len; i += REDUCE_LANES) {
+        for (R_xlen_t l = 0; l < REDUCE_LANES; ++l) {
+            auto e = x[i + l];
+            na[l] |= e == NA_INTEGER;
+            acc[l] = (isMax ? e > acc[l] : e < acc[l]) ? e : acc[l];
+        }
+    }
+    for (; i < len; ++i) {
+        na[0] |= x[i] == NA_INTEGER;
+        acc[0] = (isMax ? x[i] > acc[0] : x[i] < acc[0]) ? x[i] : acc[0];
+    }
+    auto res = acc[0];
+    for (R_xlen_t l = 0; l < REDUCE_LANES; ++l) {
+        if (na[l])
+            return Rf_ScalarInteger(NA_INTEGER);
+        res = (isMax ? acc[l] > res : acc[l] < res) ? acc[l] : res;
+    }
+    return Rf_ScalarInteger(res);
+}
+
+int anyAllImpl(SEXP v, int isAll) {
+    assert(TYPEOF(v) == LGLSXP);
+    auto x = LOGICAL(v);
+    auto len = XLENGTH(v);
+    // any stops at the first TRUE, all at the first FALSE
+    int stop = isAll ? 0 : 1;
+    int na = 0;
+    for (R_xlen_t i = 0; i < len; i += REDUCE_BLOCK) {
+        auto end = std::min(len, i + REDUCE_BLOCK);
+        int found = 0;
+        for (R_xlen_t j = i; j < end; ++j) {
+            found |= x[j] == stop;
+            na |= x[j] == NA_LOGICAL;
+        }
+        if (found)
+            return stop;
+    }
+    return na ? NA_LOGICAL : !stop;
+}
+
+SEXP whichImpl(SEXP v) {
+    assert(TYPEOF(v) == LGLSXP);
+    auto x = LOGICAL(v);
+    auto len = XLENGTH(v);
+    R_xlen_t count[REDUCE_LANES] = {};
+    R_xlen_t i = 0;
+    for (; i + REDUCE_LANES <= len; i += REDUCE_LANES)
+        for (R_xlen_t l = 0; l < REDUCE_LANES; ++l)
+            count[l] += x[i + l] == 1;
+    for (; i < len; ++i)
+        count[0] += x[i] == 1;
+    R_xlen_t n = 0;
+    for (R_xlen_t l = 0; l < REDUCE_LANES; ++l)
+        n += count[l];
+
+    auto res = PROTECT(Rf_allocVector(INTSXP, n));
+    auto r = INTEGER(res);
+    for (i = 0, n = 0; i < len; ++i)
+        if (x[i] == 1)
+            r[n++] = (int)(i + 1);
+
+    auto names = Rf_getAttrib(v, R_NamesSymbol);
+    if (names != R_NilValue) {
+        auto resNames = PROTECT(Rf_allocVector(STRSXP, n));
+        for (R_xlen_t j = 0; j < n; ++j)
+            SET_STRING_ELT(resNames, j, STRING_ELT(names, r[j] - 1));
+        Rf_setAttrib(res, R_NamesSymbol, resNames);
+        UNPROTECT(1);
+    }
+    UNPROTECT(1);
     return res;
 }
 
@@ -2138,10 +2512,17 @@ void NativeBuiltins::initializeBuiltins() {
     get_(Id::deopt) = {"deopt",
                        (void*)&deoptImpl,
                        llvm::FunctionType::get(
-                           t::t_void,
+                           t::SEXP,
                            {t::voidPtr, t::SEXP, t::voidPtr, t::stackCellPtr},
                            false),
-                       {llvm::Attribute::NoReturn}};
+                       {}};
+    get_(Id::deoptUnboxed) = {
+        "deoptUnboxed",
+        (void*)&deoptUnboxedImpl,
+        llvm::FunctionType::get(
+            t::t_void, {t::voidPtr, t::SEXP, t::voidPtr, t::stackCellPtr},
+            false),
+        {llvm::Attribute::NoReturn}};
     get_(Id::recordDeopt) = {
         "recordDeopt", (void*)&recordDeoptReason,
         llvm::FunctionType::get(
@@ -2286,11 +2667,28 @@ void NativeBuiltins::initializeBuiltins() {
         (void*)prodrImpl,
         llvm::FunctionType::get(t::Double, {t::SEXP}, false),
         {llvm::Attribute::ReadOnly, llvm::Attribute::Speculatable}};
-    get_(Id::sumr) = {
-        "sumr",
-        (void*)sumrImpl,
+    get_(Id::sumr) = {"sumr", (void*)sumrImpl,
+                      llvm::FunctionType::get(t::Double, {t::SEXP}, false)};
+    get_(Id::sumi) = {"sumi", (void*)sumiImpl,
+                      llvm::FunctionType::get(t::Int, {t::SEXP}, false)};
+    get_(Id::mean) = {
+        "mean",
+        (void*)meanImpl,
         llvm::FunctionType::get(t::Double, {t::SEXP}, false),
         {llvm::Attribute::ReadOnly, llvm::Attribute::Speculatable}};
+    get_(Id::minmaxr) = {
+        "minmaxr", (void*)minmaxrImpl,
+        llvm::FunctionType::get(t::Double, {t::SEXP, t::Int}, false)};
+    get_(Id::minmaxi) = {
+        "minmaxi", (void*)minmaxiImpl,
+        llvm::FunctionType::get(t::SEXP, {t::SEXP, t::Int}, false)};
+    get_(Id::anyAll) = {
+        "anyAll",
+        (void*)anyAllImpl,
+        llvm::FunctionType::get(t::Int, {t::SEXP, t::Int}, false),
+        {llvm::Attribute::ReadOnly, llvm::Attribute::Speculatable}};
+    get_(Id::which) = {"which", (void*)whichImpl,
+                       llvm::FunctionType::get(t::SEXP, {t::SEXP}, false)};
     get_(Id::colonInputEffects) = {
         "colonInputEffects", (void*)rir::colonInputEffects,
         llvm::FunctionType::get(t::Int, {t::SEXP, t::SEXP, t::Int}, false)};
@@ -106,6 +106,7 @@ struct NativeBuiltins {
         asLogicalBlt,
         length,
         deopt,
+        deoptUnboxed,
         recordDeopt,
         assertFail,
         printValue,
@@ -140,6 +141,12 @@ struct NativeBuiltins {
         makeVector,
         prodr,
         sumr,
+        sumi,
+        mean,
+        minmaxr,
+        minmaxi,
+        anyAll,
+        which,
         colonInputEffects,
         colonCastLhs,
         colonCastRhs,
@@ -0,0 +1,301 @@
+#include "code_cache.h"
+#include "builtins.h"
+#include "compiler/parameter.h"
+#include "interpreter/instance.h"
+#include "interpreter/interp_incl.h"
+#include "ir/BC_inc.h"
+#include "runtime/DispatchTable.h"
+#include "runtime/TypeFeedback.h"
+
+#include <Rversion.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <unistd.h>
+#include <vector>
+
+namespace rir {
+namespace pir {
+
+namespace {
+
+// Bump whenever the entry layout or the meaning of a feedback slot changes
+static constexpr unsigned FORMAT_VERSION = 1;
+
+// FNV-1a over the structure of the AST. Attributes (e.g. srcrefs) and
+// environments are deliberately ignored, they do not influence the code we
+// generate.
+struct Hasher {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    void bytes(const void* data, size_t n) {
+        auto p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < n; ++i) {
+            h ^= p[i];
+            h *= 0x100000001b3ULL;
+        }
+    }
+    template <typename T>
+    void value(T v) {
+        bytes(&v, sizeof(v));
+    }
+    void string(SEXP c) {
+        if (c == NA_STRING) {
+            value<int>(-1);
+            return;
+        }
+        value<int>(LENGTH(c));
+        bytes(CHAR(c), LENGTH(c));
+    }
+
+    void sexp(SEXP s) {
+        value<int>(TYPEOF(s));
+        switch (TYPEOF(s)) {
+        case SYMSXP:
+            string(PRINTNAME(s));
+            break;
+        case LISTSXP:
+        case LANGSXP:
+        case DOTSXP:
+            while (s != R_NilValue) {
+                sexp(TAG(s));
+                sexp(CAR(s));
+                s = CDR(s);
+            }
+            break;
+        case CHARSXP:
+            string(s);
+            break;
+        case LGLSXP:
+        case INTSXP:
+            value<R_xlen_t>(XLENGTH(s));
+            bytes(INTEGER(s), XLENGTH(s) * sizeof(int));
+            break;
+        case REALSXP:
+            value<R_xlen_t>(XLENGTH(s));
+            bytes(REAL(s), XLENGTH(s) * sizeof(double));
+            break;
+        case CPLXSXP:
+            value<R_xlen_t>(XLENGTH(s));
+            bytes(COMPLEX(s), XLENGTH(s) * sizeof(Rcomplex));
+            break;
+        case RAWSXP:
+            value<R_xlen_t>(XLENGTH(s));
+            bytes(RAW(s), XLENGTH(s));
+            break;
+        case STRSXP:
+            value<R_xlen_t>(XLENGTH(s));
+            for (R_xlen_t i = 0; i < XLENGTH(s); ++i)
+                string(STRING_ELT(s, i));
+            break;
+        case VECSXP:
+        case EXPRSXP:
+            value<R_xlen_t>(XLENGTH(s));
+            for (R_xlen_t i = 0; i < XLENGTH(s); ++i)
+                sexp(VECTOR_ELT(s, i));
+            break;
+        default:
+            // Environments, closures, external pointers, ...: only the type
+            break;
+        }
+    }
+};
+
+// Changes with every change to the bytecode, which the feedback slots and
+// contexts refer to
+uint64_t bytecodeId() {
+    static const char defs[] =
+#define DEF_INSTR(name, imm, pop, push, pure)                                  \
+    #name " " #imm " " #pop " " #push " " #pure ";"
+#include "ir/insns.h"
+        ;
+    Hasher h;
+    h.bytes(defs, sizeof(defs));
+    return h.h;
+}
+
+const std::string& fingerprint() {
+    static std::string fp = [] {
+        std::stringstream s;
+        s << "rir-code-cache " << FORMAT_VERSION << " R " << R_MAJOR << "."
+          << R_MINOR << " bc "
+          << (unsigned)Opcode::num_of << " " << std::hex << bytecodeId()
+          << std::dec << " builtins "
+          << (unsigned)NativeBuiltins::Id::NUM_BUILTINS << " ctx "
+          << sizeof(Context) << " fb " << sizeof(ObservedValues);
+        return s.str();
+    }();
+    return fp;
+}
+
+uint64_t closureHash(SEXP closure) {
+    Hasher h;
+    h.sexp(FORMALS(closure));
+    h.sexp(rirDecompile(BODY(closure)));
+    return h.h;
+}
+
+// The feedback slots of a closure in a deterministic order: body, default
+// arguments and all promises reachable from them. Call feedback is skipped,
+// the recorded targets are heap objects of this process.
+template <typename F>
+void forEachFeedbackSlot(Code* code, F f) {
+    Opcode* pc = code->code();
+    while (pc < code->endCode()) {
+        BC bc = BC::decodeShallow(pc);
+        if (bc.bc == Opcode::record_type_ || bc.bc == Opcode::record_test_)
+            f(pc + 1);
+        else if (bc.hasPromargs())
+            forEachFeedbackSlot(code->getPromise(bc.immediate.arg_idx), f);
+        pc = BC::next(pc);
+    }
+}
+
+template <typename F>
+void forEachFeedbackSlot(Function* fun, F f) {
+    forEachFeedbackSlot(fun->body(), f);
+    for (size_t i = 0; i < fun->nargs(); ++i)
+        if (auto arg = fun->defaultArg(i))
+            forEachFeedbackSlot(arg, f);
+}
+
+static_assert(sizeof(ObservedValues) == sizeof(uint32_t) &&
+                  sizeof(ObservedTest) == sizeof(uint32_t),
+              "feedback slots are stored as 32bit words");
+
+struct Entry {
+    std::vector<uint32_t> feedback;
+    std::vector<Context> contexts;
+};
+
+std::string entryPath(uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.rircache", (unsigned long long)hash);
+    return std::string(Parameter::CODE_CACHE) + name;
+}
+
+// Entry format: fingerprint line, then the number of feedback slots and
+// contexts followed by their raw contents.
+bool readEntry(uint64_t hash, Entry& e) {
+    std::ifstream in(entryPath(hash), std::ios::binary);
+    if (!in)
+        return false;
+    std::string fp;
+    std::getline(in, fp);
+    if (fp != fingerprint())
+        return false;
+    uint32_t nFeedback, nContexts;
+    in.read((char*)&nFeedback, sizeof(nFeedback));
+    in.read((char*)&nContexts, sizeof(nContexts));
+    if (!in)
+        return false;
+    e.feedback.resize(nFeedback);
+    e.contexts.resize(nContexts);
+    in.read((char*)e.feedback.data(), nFeedback * sizeof(uint32_t));
+    in.read((char*)e.contexts.data(), nContexts * sizeof(Context));
+    return (bool)in;
+}
+
+void writeEntry(uint64_t hash, const Entry& e) {
+    // Write to a temporary file and rename, such that concurrent processes
+    // never observe a partial entry
+    auto path = entryPath(hash);
+    std::stringstream tmp;
+    tmp << path << "." << getpid() << ".tmp";
+    {
+        std::ofstream out(tmp.str(), std::ios::binary | std::ios::trunc);
+        if (!out)
+            return;
+        uint32_t nFeedback = e.feedback.size();
+        uint32_t nContexts = e.contexts.size();
+        out << fingerprint() << "\n";
+        out.write((const char*)&nFeedback, sizeof(nFeedback));
+        out.write((const char*)&nContexts, sizeof(nContexts));
+        out.write((const char*)e.feedback.data(), nFeedback * sizeof(uint32_t));
+        out.write((const char*)e.contexts.data(), nContexts * sizeof(Context));
+        if (!out) {
+            remove(tmp.str().c_str());
+            return;
+        }
+    }
+    if (rename(tmp.str().c_str(), path.c_str()) != 0)
+        remove(tmp.str().c_str());
+}
+
+// Contexts already written by this process, to avoid rewriting entries
+std::unordered_map<uint64_t, std::unordered_set<Context>>& written() {
+    static std::unordered_map<uint64_t, std::unordered_set<Context>> w;
+    return w;
+}
+
+} // namespace
+
+bool CodeCache::enabled() { return Parameter::CODE_CACHE; }
+
+bool CodeCache::restore(SEXP closure, DispatchTable* table, SEXP name,
+                        InterpreterInstance* ctx) {
+    auto hash = closureHash(closure);
+    Entry e;
+    if (!readEntry(hash, e))
+        return false;
+
+    auto baseline = table->baseline();
+    size_t slots = 0;
+    forEachFeedbackSlot(baseline, [&](Opcode*) { slots++; });
+    // Same source but different bytecode (e.g. the rir compiler changed)
+    if (slots != e.feedback.size())
+        return false;
+
+    auto& w = written()[hash];
+    for (auto c : e.contexts)
+        w.insert(c);
+
+    size_t i = 0;
+    forEachFeedbackSlot(baseline, [&](Opcode* slot) {
+        memcpy(slot, &e.feedback[i++], sizeof(uint32_t));
+    });
+
+    for (auto c : e.contexts)
+        ctx->closureOptimizer(closure, c, name);
+    return !e.contexts.empty();
+}
+
+void CodeCache::store(SEXP closure, const Context& context) {
+    if (TYPEOF(closure) != CLOSXP || !DispatchTable::check(BODY(closure)))
+        return;
+    auto hash = closureHash(closure);
+    auto& w = written()[hash];
+    if (w.count(context))
+        return;
+
+    Entry e;
+    // Merge with entries from other processes. Stale entries are overwritten.
+    if (!readEntry(hash, e))
+        e = Entry();
+    for (auto c : e.contexts)
+        w.insert(c);
+    if (!w.insert(context).second)
+        return;
+    e.contexts.assign(w.begin(), w.end());
+
+    e.feedback.clear();
+    auto baseline = DispatchTable::unpack(BODY(closure))->baseline();
+    forEachFeedbackSlot(baseline, [&](Opcode* slot) {
+        uint32_t v;
+        memcpy(&v, slot, sizeof(v));
+        e.feedback.push_back(v);
+    });
+    writeEntry(hash, e);
+}
+
+const char* Parameter::CODE_CACHE =
+    getenv("PIR_CODE_CACHE") && *getenv("PIR_CODE_CACHE")
+        ? getenv("PIR_CODE_CACHE")
+        : nullptr;
+
+} // namespace pir
+} // namespace rir
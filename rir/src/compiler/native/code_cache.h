@@ -0,0 +1,45 @@
+#ifndef RIR_COMPILER_CODE_CACHE_H
+#define RIR_COMPILER_CODE_CACHE_H
+
+#include "R/r.h"
+#include "runtime/Context.h"
+
+namespace rir {
+
+struct DispatchTable;
+struct InterpreterInstance;
+
+namespace pir {
+
+// Persistent warm-up cache, enabled by PIR_CODE_CACHE=<dir>.
+//
+// Native code cannot be reused across processes: it references runtime
+// objects through absolute addresses and constant pool indices baked into the
+// object file. What can be reused is everything needed to reproduce the
+// compilation: the type feedback of the baseline version and the contexts we
+// optimized for. Entries are keyed by a structural hash of the closure source
+// and tagged with a fingerprint of R, the bytecode definitions and the native
+// builtins ABI. A mismatching fingerprint means the entry is ignored. Neither
+// depends on LLVM, which only generates the code again.
+//
+// When a closure reaches the optimization threshold for the first time, the
+// feedback is restored and all cached versions are compiled eagerly, skipping
+// the rest of the warm-up phase. Cold closures never pay for hashing their
+// source or for looking up their entry.
+class CodeCache {
+  public:
+    static bool enabled();
+
+    // Called when a closure first reaches the optimization threshold. Returns
+    // true if versions were compiled from the cache.
+    static bool restore(SEXP closure, DispatchTable* table, SEXP name,
+                        InterpreterInstance* ctx);
+
+    // Record that closure was optimized for the given context.
+    static void store(SEXP closure, const Context& context);
+};
+
+} // namespace pir
+} // namespace rir
+
+#endif
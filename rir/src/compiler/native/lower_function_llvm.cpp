@@ -3,6 +3,7 @@
 #include "R/Funtab.h"
 #include "R/Symbols.h"
 #include "R/r.h"
+#include "compiler/analysis/loop_detection.h"
 #include "compiler/analysis/reference_count.h"
 #include "compiler/native/builtins.h"
 #include "compiler/native/representation_llvm.h"
@@ -12,6 +13,7 @@
 #include "compiler/util/lowering/allocators.h"
 #include "compiler/util/visitor.h"
 #include "interpreter/builtins.h"
+#include "interpreter/cache.h"
 #include "interpreter/instance.h"
 #include "runtime/DispatchTable.h"
 #include "runtime/LazyArglist.h"
@@ -185,7 +187,7 @@ void LowerFunctionLLVM::insn_assert(llvm::Value* v, const char* msg,
         call(NativeBuiltins::get(NativeBuiltins::Id::printValue), {p});
     call(NativeBuiltins::get(NativeBuiltins::Id::assertFail),
          {convertToPointer((void*)msg, t::i8, true)});
-    builder.CreateRet(builder.CreateIntToPtr(c(nullptr), t::SEXP));
+    builder.CreateRet(llvm::Constant::getNullValue(fun->getReturnType()));
 
     builder.SetInsertPoint(ok);
 }
@@ -387,6 +389,47 @@ LowerFunctionLLVM::withCallFrame(const std::vector<Value*>& args,
     return res;
 }
 
+llvm::Value* LowerFunctionLLVM::callUnboxed(StaticCall* calli,
+                                            ClosureVersion* target,
+                                            llvm::Value* code,
+                                            const std::vector<Value*>& args) {
+    auto unboxed = getUnboxedFunction(target);
+    if (!unboxed.first || unboxed.second->args.size() != args.size())
+        return nullptr;
+    auto& sig = *unboxed.second;
+
+    // The dispatch guarantees that the arguments have the types the callee
+    // assumes, including the ones it unboxes
+    std::vector<Value*> boxedArgs;
+    std::vector<Value*> callArgs;
+    for (size_t a = 0; a < args.size(); ++a) {
+        auto arg = args[a];
+        if (sig.args[a] == Representation::Sexp) {
+            boxedArgs.push_back(arg);
+        } else if (auto mk = MkArg::Cast(arg)) {
+            if (!mk->isEager())
+                return nullptr;
+            arg = mk->eagerArg();
+        }
+        callArgs.push_back(arg);
+    }
+
+    // Boxed arguments are kept on the stack for the gc
+    auto res = withCallFrame(boxedArgs, [&]() -> llvm::Value* {
+        std::vector<llvm::Value*> params = {
+            code, llvm::ConstantPointerNull::get(t::stackCellPtr),
+            loadSxp(calli->env()),
+            constant(target->owner()->rirClosure(), t::SEXP)};
+        for (size_t a = 0; a < callArgs.size(); ++a)
+            params.push_back(load(callArgs[a], sig.args[a]));
+        return builder.CreateCall(unboxed.first, params);
+    });
+    if (sig.result == Representation::Sexp ||
+        Representation::Of(calli) == sig.result)
+        return res;
+    return box(res, sig.resultType, false);
+}
+
 llvm::Value* LowerFunctionLLVM::load(Value* v, Representation r) {
     return load(v, v->type, r);
 }
@@ -507,15 +550,13 @@ llvm::Value* LowerFunctionLLVM::load(Value* val, PirType type,
 llvm::Value* LowerFunctionLLVM::computeAndCheckIndex(Value* index,
                                                      llvm::Value* vector,
                                                      BasicBlock* fallback,
-                                                     llvm::Value* max) {
-    BasicBlock* hit1 = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
-    BasicBlock* hit = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
-
+                                                     llvm::Value* max,
+                                                     bool inBounds) {
     auto representation = Representation::Of(index);
     llvm::Value* nativeIndex = load(index);
 
     if (representation == Representation::Sexp) {
-        if (Representation::Of(index->type) == Representation::Integer) {
+        if (Representation::Of(index->type).isIntLike()) {
             nativeIndex = unboxInt(nativeIndex);
             representation = Representation::Integer;
         } else {
@@ -524,23 +565,35 @@ llvm::Value* LowerFunctionLLVM::computeAndCheckIndex(Value* index,
         }
     }
 
+    // Proven in bounds and not NA (see IndexRangeAnalysis), only convert
+    if (inBounds) {
+        if (representation == Representation::Real) {
+            nativeIndex = builder.CreateFPToUI(nativeIndex, t::i64);
+        } else {
+            assert(representation.isIntLike());
+            nativeIndex = builder.CreateZExt(nativeIndex, t::i64);
+        }
+        return builder.CreateSub(nativeIndex, c(1ul), "", true, true);
+    }
+
+    BasicBlock* hit1 = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    BasicBlock* hit = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+
     if (representation == Representation::Real) {
+        // Unordered compare, thus NaN is also caught here
         auto indexUnderRange = builder.CreateFCmpULT(nativeIndex, c(1.0));
         auto indexOverRange =
             builder.CreateFCmpUGE(nativeIndex, c((double)ULONG_MAX));
-        auto indexNa = builder.CreateFCmpUNE(nativeIndex, nativeIndex);
-        auto fail = builder.CreateOr(indexUnderRange,
-                                     builder.CreateOr(indexOverRange, indexNa));
+        auto fail = builder.CreateOr(indexUnderRange, indexOverRange);
 
         builder.CreateCondBr(fail, fallback, hit1, branchMostlyFalse);
         builder.SetInsertPoint(hit1);
 
         nativeIndex = builder.CreateFPToUI(nativeIndex, t::i64);
     } else {
-        assert(representation == Representation::Integer);
-        auto indexUnderRange = builder.CreateICmpSLT(nativeIndex, c(1));
-        auto indexNa = builder.CreateICmpEQ(nativeIndex, c(NA_INTEGER));
-        auto fail = builder.CreateOr(indexUnderRange, indexNa);
+        assert(representation.isIntLike());
+        // NA_INTEGER is negative, thus also caught here
+        auto fail = builder.CreateICmpSLT(nativeIndex, c(1));
 
         builder.CreateCondBr(fail, fallback, hit1, branchMostlyFalse);
         builder.SetInsertPoint(hit1);
@@ -847,6 +900,8 @@ llvm::Value* LowerFunctionLLVM::unboxRealIntLgl(llvm::Value* v,
 }
 
 llvm::Value* LowerFunctionLLVM::argument(int i) {
+    if (unboxedEntry)
+        return fun->arg_begin() + argNames.size() + i;
     auto pos = builder.CreateGEP(paramArgs(), c(i));
     pos = builder.CreateGEP(pos, {c(0), c(1)});
     return builder.CreateLoad(t::SEXP, pos);
@@ -1512,6 +1567,372 @@ llvm::Value* LowerFunctionLLVM::depromise(Value* v) {
     return depromise(loadSxp(v), v->type);
 }
 
+llvm::Value* LowerFunctionLLVM::elementwiseOp(BinopKind kind, llvm::Value* x,
+                                              llvm::Value* y) {
+    bool relop = kind != BinopKind::ADD && kind != BinopKind::SUB &&
+                 kind != BinopKind::MUL && kind != BinopKind::DIV;
+    bool intCompare = relop && x->getType() == t::Int && y->getType() == t::Int;
+
+    // Integer NA becomes NA_REAL, any NaN propagates through the fp operation
+    auto toDouble = [&](llvm::Value* v) -> llvm::Value* {
+        if (v->getType() == t::Double)
+            return v;
+        return builder.CreateSelect(builder.CreateICmpEQ(v, c(NA_INTEGER)),
+                                    c(NA_REAL),
+                                    builder.CreateSIToFP(v, t::Double));
+    };
+    if (!intCompare) {
+        x = toDouble(x);
+        y = toDouble(y);
+    }
+
+    switch (kind) {
+    case BinopKind::ADD:
+        return builder.CreateFAdd(x, y);
+    case BinopKind::SUB:
+        return builder.CreateFSub(x, y);
+    case BinopKind::MUL:
+        return builder.CreateFMul(x, y);
+    case BinopKind::DIV:
+        return builder.CreateFDiv(x, y);
+    default:
+        break;
+    }
+
+    llvm::Value* isNa;
+    llvm::Value* cmp;
+    if (intCompare) {
+        isNa = builder.CreateOr(builder.CreateICmpEQ(x, c(NA_INTEGER)),
+                                builder.CreateICmpEQ(y, c(NA_INTEGER)));
+        switch (kind) {
+        case BinopKind::EQ:
+            cmp = builder.CreateICmpEQ(x, y);
+            break;
+        case BinopKind::NE:
+            cmp = builder.CreateICmpNE(x, y);
+            break;
+        case BinopKind::LT:
+            cmp = builder.CreateICmpSLT(x, y);
+            break;
+        case BinopKind::LTE:
+            cmp = builder.CreateICmpSLE(x, y);
+            break;
+        case BinopKind::GT:
+            cmp = builder.CreateICmpSGT(x, y);
+            break;
+        default:
+            cmp = builder.CreateICmpSGE(x, y);
+            break;
+        }
+    } else {
+        isNa = builder.CreateFCmpUNO(x, y);
+        switch (kind) {
+        case BinopKind::EQ:
+            cmp = builder.CreateFCmpOEQ(x, y);
+            break;
+        case BinopKind::NE:
+            cmp = builder.CreateFCmpONE(x, y);
+            break;
+        case BinopKind::LT:
+            cmp = builder.CreateFCmpOLT(x, y);
+            break;
+        case BinopKind::LTE:
+            cmp = builder.CreateFCmpOLE(x, y);
+            break;
+        case BinopKind::GT:
+            cmp = builder.CreateFCmpOGT(x, y);
+            break;
+        default:
+            cmp = builder.CreateFCmpOGE(x, y);
+            break;
+        }
+    }
+    return builder.CreateSelect(isNa, c(NA_LOGICAL),
+                                builder.CreateZExt(cmp, t::Int));
+}
+
+static BinopKind elementwiseKind(Tag op) {
+    switch (op) {
+    case Tag::Add:
+        return BinopKind::ADD;
+    case Tag::Sub:
+        return BinopKind::SUB;
+    case Tag::Mul:
+        return BinopKind::MUL;
+    case Tag::Div:
+        return BinopKind::DIV;
+    case Tag::Lt:
+        return BinopKind::LT;
+    case Tag::Lte:
+        return BinopKind::LTE;
+    case Tag::Gt:
+        return BinopKind::GT;
+    case Tag::Gte:
+        return BinopKind::GTE;
+    case Tag::Eq:
+        return BinopKind::EQ;
+    case Tag::Neq:
+        return BinopKind::NE;
+    default:
+        assert(false);
+    }
+    return BinopKind::ADD;
+}
+
+void LowerFunctionLLVM::compileElementwise(Instruction* instr) {
+    auto i = Elementwise::Cast(instr);
+    assert(Representation::Of(i) == Representation::Sexp);
+    auto kind = [](const Elementwise::Node& n) {
+        return elementwiseKind(n.op);
+    };
+    auto rootKind = kind(i->root());
+    bool relop = rootKind != BinopKind::ADD && rootKind != BinopKind::SUB &&
+                 rootKind != BinopKind::MUL && rootKind != BinopKind::DIV;
+
+    // Scalar leaves are unboxed once, vector leaves accessed in the loop
+    std::vector<llvm::Value*> scalars(i->nLeaves(), nullptr);
+    std::vector<llvm::Value*> vectors(i->nLeaves(), nullptr);
+    llvm::Value* n = nullptr;
+    llvm::Value* ok = nullptr;
+    for (size_t k = 0; k < i->nLeaves(); ++k) {
+        auto v = i->arg(k).val();
+        auto rep = Representation::Of(v);
+        if (rep != Representation::Sexp) {
+            scalars[k] = load(v, rep);
+        } else if (v->type.isSimpleScalar()) {
+            scalars[k] = load(v, v->type,
+                              v->type.isA(PirType(RType::integer))
+                                  ? Representation::Integer
+                                  : Representation::Real);
+        } else {
+            auto vec = loadSxp(v);
+            auto l = vectorLength(vec);
+            if (!n) {
+                n = l;
+                ok = builder.CreateICmpNE(l, c(0, 64));
+            } else {
+                ok = builder.CreateAnd(ok, builder.CreateICmpEQ(l, n));
+            }
+            vectors[k] = builder.CreateBitCast(
+                dataPtr(vec, false), v->type.isA(PirType(RType::integer))
+                                         ? t::IntPtr
+                                         : t::DoublePtr);
+        }
+    }
+    assert(n && "Fused elementwise operation without vector operand");
+
+    auto fast = BasicBlock::Create(PirJitLLVM::getContext(), "fused", fun);
+    auto slow = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto done = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto res = phiBuilder(t::SEXP);
+
+    // Recycling needs a warning (or is rare enough), evaluate the tree
+    // operation by operation in that case
+    builder.CreateCondBr(ok, fast, slow, branchAlwaysTrue);
+
+    builder.SetInsertPoint(slow);
+    {
+        std::vector<llvm::Value*> leaves(i->nLeaves(), nullptr);
+        std::vector<llvm::Value*> vals;
+        auto e = i->hasEnv() ? loadSxp(i->env()) : nullptr;
+        for (auto& node : i->nodes) {
+            llvm::Value* r;
+            if (node.leaf()) {
+                if (!leaves[node.lhs]) {
+                    leaves[node.lhs] = loadSxp(i->arg(node.lhs).val());
+                    protectTemp(leaves[node.lhs]);
+                }
+                vals.push_back(leaves[node.lhs]);
+                continue;
+            }
+            if (e) {
+                r = call(NativeBuiltins::get(NativeBuiltins::Id::binopEnv),
+                         {vals.at(node.lhs), vals.at(node.rhs), e,
+                          c(node.srcIdx), c((int)kind(node))});
+            } else {
+                r = call(NativeBuiltins::get(NativeBuiltins::Id::binop),
+                         {vals.at(node.lhs), vals.at(node.rhs),
+                          c((int)kind(node))});
+            }
+            protectTemp(r);
+            vals.push_back(r);
+        }
+        res.addInput(vals.back());
+        builder.CreateBr(done);
+    }
+
+    builder.SetInsertPoint(fast);
+    auto result = call(NativeBuiltins::get(NativeBuiltins::Id::makeVector),
+                       {c(relop ? LGLSXP : REALSXP), n});
+    auto pr = builder.CreateBitCast(dataPtr(result, false),
+                                    relop ? t::IntPtr : t::DoublePtr);
+
+    auto head = builder.GetInsertBlock();
+    auto body = BasicBlock::Create(PirJitLLVM::getContext(), "fused-loop", fun);
+    builder.CreateBr(body);
+    builder.SetInsertPoint(body);
+
+    auto idx = phiBuilder(t::i64);
+    idx.addInput(c(0, 64), head);
+    auto idxPhi = idx(2);
+    std::vector<llvm::Value*> vals;
+    for (auto& node : i->nodes) {
+        if (!node.leaf()) {
+            vals.push_back(elementwiseOp(kind(node), vals.at(node.lhs),
+                                         vals.at(node.rhs)));
+        } else if (scalars[node.lhs]) {
+            vals.push_back(scalars[node.lhs]);
+        } else {
+            vals.push_back(builder.CreateLoad(
+                builder.CreateInBoundsGEP(vectors[node.lhs], idxPhi)));
+        }
+    }
+    builder.CreateStore(vals.back(), builder.CreateInBoundsGEP(pr, idxPhi));
+    auto next = builder.CreateAdd(idxPhi, c(1, 64), "", true, true);
+    idx.addInput(next);
+
+    auto exit = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    builder.CreateCondBr(builder.CreateICmpEQ(next, n), exit, body);
+    builder.SetInsertPoint(exit);
+    res.addInput(result);
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(done);
+    setVal(i, res());
+}
+
+bool LowerFunctionLLVM::compileVectorBinop(Instruction* i, Value* lhs,
+                                           Value* rhs, BinopKind kind) {
+    if (Representation::Of(i) != Representation::Sexp)
+        return false;
+
+    auto plainVector = [](Value* v) {
+        return v->type.isA(PirType(RType::real)) ||
+               v->type.isA(PirType(RType::integer));
+    };
+    if (!plainVector(lhs) || !plainVector(rhs))
+        return false;
+
+    bool lhsReal = !lhs->type.isA(PirType(RType::integer));
+    bool rhsReal = !rhs->type.isA(PirType(RType::integer));
+    bool relop = false;
+    switch (kind) {
+    case BinopKind::ADD:
+    case BinopKind::SUB:
+    case BinopKind::MUL:
+        // Integer arithmetic can overflow, which produces a warning
+        if (!lhsReal && !rhsReal)
+            return false;
+        break;
+    case BinopKind::DIV:
+        break;
+    case BinopKind::EQ:
+    case BinopKind::NE:
+    case BinopKind::LT:
+    case BinopKind::LTE:
+    case BinopKind::GT:
+    case BinopKind::GTE:
+        relop = true;
+        break;
+    default:
+        return false;
+    }
+
+    auto a = loadSxp(lhs);
+    auto b = loadSxp(rhs);
+    auto la = vectorLength(a);
+    auto lb = vectorLength(b);
+
+    auto fast = BasicBlock::Create(PirJitLLVM::getContext(), "vecBinop", fun);
+    auto slow = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto done = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto res = phiBuilder(t::SEXP);
+
+    // Mismatching lengths need a warning, empty vectors are not worth it
+    auto sameLength = builder.CreateICmpEQ(la, lb);
+    auto recycle = builder.CreateOr(builder.CreateICmpEQ(la, c(1, 64)),
+                                    builder.CreateICmpEQ(lb, c(1, 64)));
+    auto nonEmpty = builder.CreateAnd(builder.CreateICmpNE(la, c(0, 64)),
+                                      builder.CreateICmpNE(lb, c(0, 64)));
+    builder.CreateCondBr(
+        builder.CreateAnd(builder.CreateOr(sameLength, recycle), nonEmpty),
+        fast, slow, branchAlwaysTrue);
+
+    builder.SetInsertPoint(slow);
+    if (i->hasEnv()) {
+        auto e = loadSxp(i->env());
+        res.addInput(call(NativeBuiltins::get(NativeBuiltins::Id::binopEnv),
+                          {a, b, e, c(i->srcIdx), c((int)kind)}));
+    } else {
+        res.addInput(call(NativeBuiltins::get(NativeBuiltins::Id::binop),
+                          {a, b, c((int)kind)}));
+    }
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(fast);
+    auto n = builder.CreateSelect(builder.CreateICmpUGT(la, lb), la, lb);
+    auto result = call(NativeBuiltins::get(NativeBuiltins::Id::makeVector),
+                       {c(relop ? LGLSXP : REALSXP), n});
+    auto pa = builder.CreateBitCast(dataPtr(a, false),
+                                    lhsReal ? t::DoublePtr : t::IntPtr);
+    auto pb = builder.CreateBitCast(dataPtr(b, false),
+                                    rhsReal ? t::DoublePtr : t::IntPtr);
+    auto pr = builder.CreateBitCast(dataPtr(result, false),
+                                    relop ? t::IntPtr : t::DoublePtr);
+
+    // One loop per recycling pattern. The recycled operand is loaded once in
+    // front of the loop, such that every loop body is a plain map over
+    // contiguous memory which the loop vectorizer can handle.
+    auto loop = [&](bool scalarA, bool scalarB) {
+        auto x0 = scalarA ? builder.CreateLoad(pa) : nullptr;
+        auto y0 = scalarB ? builder.CreateLoad(pb) : nullptr;
+
+        auto head = builder.GetInsertBlock();
+        auto body =
+            BasicBlock::Create(PirJitLLVM::getContext(), "vecBinop-loop", fun);
+        builder.CreateBr(body);
+        builder.SetInsertPoint(body);
+
+        auto idx = phiBuilder(t::i64);
+        idx.addInput(c(0, 64), head);
+        auto idxPhi = idx(2);
+        auto x = x0 ? x0
+                    : builder.CreateLoad(builder.CreateInBoundsGEP(pa, idxPhi));
+        auto y = y0 ? y0
+                    : builder.CreateLoad(builder.CreateInBoundsGEP(pb, idxPhi));
+        builder.CreateStore(elementwiseOp(kind, x, y),
+                            builder.CreateInBoundsGEP(pr, idxPhi));
+        auto next = builder.CreateAdd(idxPhi, c(1, 64), "", true, true);
+        idx.addInput(next);
+
+        auto exit = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+        builder.CreateCondBr(builder.CreateICmpEQ(next, n), exit, body);
+        builder.SetInsertPoint(exit);
+        res.addInput(result);
+        builder.CreateBr(done);
+    };
+
+    auto same = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto notSame = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto scalarLhs = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto scalarRhs = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    builder.CreateCondBr(sameLength, same, notSame);
+    builder.SetInsertPoint(notSame);
+    builder.CreateCondBr(builder.CreateICmpEQ(la, c(1, 64)), scalarLhs,
+                         scalarRhs);
+
+    builder.SetInsertPoint(same);
+    loop(false, false);
+    builder.SetInsertPoint(scalarLhs);
+    loop(true, false);
+    builder.SetInsertPoint(scalarRhs);
+    loop(false, true);
+
+    builder.SetInsertPoint(done);
+    setVal(i, res());
+    return true;
+}
+
 void LowerFunctionLLVM::compileRelop(
     Instruction* i,
     const std::function<llvm::Value*(llvm::Value*, llvm::Value*)>& intInsert,
@@ -1523,6 +1944,9 @@ void LowerFunctionLLVM::compileRelop(
     auto lhsRep = Representation::Of(lhs);
     auto rhsRep = Representation::Of(rhs);
     if (lhsRep == Representation::Sexp || rhsRep == Representation::Sexp) {
+        if (compileVectorBinop(i, lhs, rhs, kind))
+            return;
+
         auto a = loadSxp(lhs);
         auto b = loadSxp(rhs);
 
@@ -1589,8 +2013,10 @@ void LowerFunctionLLVM::compileBinop(
     auto rhsRep = Representation::Of(rhs);
 
     if (lhsRep == Representation::Sexp || rhsRep == Representation::Sexp ||
-        (!fpInsert && (lhsRep != Representation::Integer ||
-                       rhsRep != Representation::Integer))) {
+        (!fpInsert && (!lhsRep.isIntLike() || !rhsRep.isIntLike()))) {
+        if (compileVectorBinop(i, lhs, rhs, kind))
+            return;
+
         auto a = loadSxp(lhs);
         auto b = loadSxp(rhs);
 
@@ -1621,7 +2047,7 @@ void LowerFunctionLLVM::compileBinop(
 
     auto checkNa = [&](llvm::Value* llvmValue, PirType type, Representation r) {
         if (type.maybeNAOrNaN()) {
-            if (r == Representation::Integer) {
+            if (r.isIntLike()) {
                 if (!isNaBr)
                     isNaBr = BasicBlock::Create(PirJitLLVM::getContext(),
                                                 "isNa", fun);
@@ -1643,8 +2069,7 @@ void LowerFunctionLLVM::compileBinop(
     }
     builder.CreateBr(done);
 
-    if (lhsRep == Representation::Integer ||
-        rhsRep == Representation::Integer) {
+    if (lhsRep.isIntLike() || rhsRep.isIntLike()) {
         if (isNaBr) {
             builder.SetInsertPoint(isNaBr);
 
@@ -1698,7 +2123,7 @@ void LowerFunctionLLVM::compileUnop(
 
     auto checkNa = [&](llvm::Value* value, PirType type, Representation r) {
         if (type.maybeNAOrNaN()) {
-            if (r == Representation::Integer) {
+            if (r.isIntLike()) {
                 if (!isNaBr)
                     isNaBr = BasicBlock::Create(PirJitLLVM::getContext(),
                                                 "isNa", fun);
@@ -1715,7 +2140,7 @@ void LowerFunctionLLVM::compileUnop(
     }
     builder.CreateBr(done);
 
-    if (argRep == Representation::Integer) {
+    if (argRep.isIntLike()) {
         if (isNaBr) {
             builder.SetInsertPoint(isNaBr);
 
@@ -2173,12 +2598,28 @@ void LowerFunctionLLVM::compile() {
     std::unordered_map<BB*, int> blockInPushContext;
     blockInPushContext[code->entry] = 0;
 
+    std::unordered_set<BB*> loopHeaders;
+    if (loopCounter) {
+        LoopDetection loops(code);
+        for (auto& loop : loops)
+            loopHeaders.insert(loop.header());
+    }
+
     LoweringVisitor::run(code->entry, [&](BB* bb) {
         currentBB = bb;
 
         builder.SetInsertPoint(getBlock(bb));
         inPushContext = blockInPushContext.at(bb);
 
+        if (loopHeaders.count(bb)) {
+            auto counter = convertToPointer(loopCounter, t::Int);
+            auto n = builder.CreateLoad(counter);
+            auto saturated = builder.CreateICmpEQ(n, c(UINT_MAX));
+            builder.CreateStore(
+                builder.CreateSelect(saturated, n, builder.CreateAdd(n, c(1))),
+                counter);
+        }
+
         if (LLVMDebugInfo()) {
             DI->emitLocation(builder, DI->getBBLoc(bb));
         }
@@ -2203,7 +2644,7 @@ void LowerFunctionLLVM::compile() {
                     auto rep = Representation::Of(i);
                     auto ditype = (rep == Representation::Sexp
                                        ? DI->SEXPType
-                                       : (rep == Representation::Integer
+                                       : (rep.isIntLike()
                                               ? DI->IntType
                                               : (rep == Representation::Real
                                                      ? DI->DoubleType
@@ -2470,8 +2911,7 @@ void LowerFunctionLLVM::compile() {
                                                     "isNa", fun);
                                             nacheck(vv, v->type, isNaBr);
                                         } else {
-                                            assert(rep ==
-                                                   Representation::Integer);
+                                            assert(rep.isIntLike());
                                             if (!isNaBr)
                                                 isNaBr = BasicBlock::Create(
                                                     PirJitLLVM::getContext(),
@@ -2681,7 +3121,8 @@ void LowerFunctionLLVM::compile() {
                         break;
                     }
                     case blt("abs"): {
-                        if (irep == orep && irep == Representation::Integer) {
+                        if (irep.isIntLike() &&
+                            orep == Representation::Integer) {
                             setVal(i, builder.CreateSelect(
                                           builder.CreateICmpSGE(a, c(0)), a,
                                           builder.CreateNeg(a)));
@@ -2698,8 +3139,7 @@ void LowerFunctionLLVM::compile() {
                         break;
                     }
                     case blt("sqrt"): {
-                        if (orep == Representation::Real &&
-                            irep == Representation::Integer) {
+                        if (orep == Representation::Real && irep.isIntLike()) {
                             a = convert(a, i->type);
                             setVal(i, builder.CreateIntrinsic(
                                           Intrinsic::sqrt, {t::Double}, {a}));
@@ -2752,23 +3192,19 @@ void LowerFunctionLLVM::compile() {
                     }
                     case blt("sum"):
                     case blt("prod"): {
-                        if (irep == Representation::Integer ||
-                            irep == Representation::Real) {
+                        if (irep.isIntLike() || irep == Representation::Real) {
                             setVal(i, convert(a, i->type));
                         } else if (orep == Representation::Real ||
                                    orep == Representation::Integer) {
                             assert(irep == Representation::Sexp);
                             auto itype = b->callArg(0).val()->type;
-                            if (itype.isA(PirType::intReal())) {
-                                auto trg = b->builtinId == blt("sum")
-                                               ? NativeBuiltins::get(
-                                                     NativeBuiltins::Id::sumr)
-                                               : NativeBuiltins::get(
-                                                     NativeBuiltins::Id::prodr);
-                                llvm::Value* res = call(trg, {a});
-                                if (orep == Representation::Integer)
-                                    res = convert(res, i->type);
-                                setVal(i, res);
+                            if (itype.isA(PirType::intRealLgl())) {
+                                auto trg = NativeBuiltins::Id::prodr;
+                                if (b->builtinId == blt("sum"))
+                                    trg = orep == Representation::Integer
+                                              ? NativeBuiltins::Id::sumi
+                                              : NativeBuiltins::Id::sumr;
+                                setVal(i, call(NativeBuiltins::get(trg), {a}));
                             } else {
                                 done = false;
                             }
@@ -2777,9 +3213,83 @@ void LowerFunctionLLVM::compile() {
                         }
                         break;
                     }
+                    case blt("mean"): {
+                        auto itype = b->callArg(0).val()->type;
+                        if (orep != Representation::Real) {
+                            done = false;
+                        } else if (irep.isIntLike() ||
+                                   irep == Representation::Real) {
+                            setVal(i, convert(a, i->type));
+                        } else if (itype.isA(PirType::intRealLgl())) {
+                            setVal(i, call(NativeBuiltins::get(
+                                               NativeBuiltins::Id::mean),
+                                           {a}));
+                        } else {
+                            done = false;
+                        }
+                        break;
+                    }
+                    case blt("min"):
+                    case blt("max"): {
+                        auto itype = b->callArg(0).val()->type;
+                        auto isMax = c((int)(b->builtinId == blt("max")));
+                        if (irep != Representation::Sexp &&
+                            (irep == orep ||
+                             (irep.isIntLike() && orep.isIntLike()))) {
+                            setVal(i, a);
+                        } else if (irep == Representation::Sexp &&
+                                   orep == Representation::Real &&
+                                   itype.isA(RType::real)) {
+                            setVal(i, call(NativeBuiltins::get(
+                                               NativeBuiltins::Id::minmaxr),
+                                           {a, isMax}));
+                        } else if (irep == Representation::Sexp &&
+                                   orep == Representation::Sexp &&
+                                   itype.isA(RType::integer)) {
+                            setVal(i, call(NativeBuiltins::get(
+                                               NativeBuiltins::Id::minmaxi),
+                                           {a, isMax}));
+                        } else {
+                            done = false;
+                        }
+                        break;
+                    }
+                    case blt("any"):
+                    case blt("all"): {
+                        auto itype = b->callArg(0).val()->type;
+                        if (irep == Representation::Sexp &&
+                            orep == Representation::Logical &&
+                            itype.isA(RType::logical)) {
+                            auto isAll = c((int)(b->builtinId == blt("all")));
+                            setVal(i, call(NativeBuiltins::get(
+                                               NativeBuiltins::Id::anyAll),
+                                           {a, isAll}));
+                        } else {
+                            done = false;
+                        }
+                        break;
+                    }
+                    case blt("which"): {
+                        auto itype = b->callArg(0).val()->type;
+                        if (irep == Representation::Sexp &&
+                            orep == Representation::Sexp &&
+                            itype.isA(PirType(RType::logical)
+                                          .orAttribsOrObj()
+                                          .notObject())) {
+                            setVal(i, call(NativeBuiltins::get(
+                                               NativeBuiltins::Id::which),
+                                           {a}));
+                        } else {
+                            done = false;
+                        }
+                        break;
+                    }
                     case blt("as.logical"):
-                        if (irep == Representation::Integer &&
-                            orep == Representation::Integer) {
+                        if (irep == Representation::Logical &&
+                            orep == Representation::Logical) {
+                            setVal(i, a);
+                        } else if (irep == Representation::Integer &&
+                                   orep == Representation::Logical) {
                             setVal(i,
                                    builder.CreateSelect(
                                        builder.CreateICmpEQ(a, c(NA_INTEGER)),
@@ -2790,8 +3300,7 @@ void LowerFunctionLLVM::compile() {
                                            constant(R_TrueValue, orep))));
 
                         } else if (irep == Representation::Real &&
-                                   (orep == Representation::Integer ||
-                                    orep == Representation::Real)) {
+                                   orep == Representation::Logical) {
 
                             setVal(i, builder.CreateSelect(
                                           builder.CreateFCmpUNE(a, a),
@@ -2806,7 +3315,7 @@ void LowerFunctionLLVM::compile() {
                         }
                         break;
                     case blt("as.integer"):
-                        if (irep == Representation::Integer &&
+                        if (irep.isIntLike() &&
                             orep == Representation::Integer) {
                             setVal(i, a);
                         } else if (irep == Representation::Real &&
@@ -2922,7 +3431,7 @@ void LowerFunctionLLVM::compile() {
                     }
                     case blt("anyNA"):
                     case blt("is.na"):
-                        if (irep == Representation::Integer) {
+                        if (irep.isIntLike()) {
                             setVal(i,
                                    builder.CreateSelect(
                                        builder.CreateICmpEQ(a, c(NA_INTEGER)),
@@ -3074,8 +3583,7 @@ void LowerFunctionLLVM::compile() {
                     case blt("min"):
                     case blt("max"): {
                         bool isMin = b->builtinId == blt("min");
-                        if (arep == Representation::Integer &&
-                            brep == Representation::Integer &&
+                        if (arep.isIntLike() && brep.isIntLike() &&
                             orep != Representation::Real) {
                             auto res = builder.CreateSelect(
                                 isMin ? builder.CreateICmpSLT(bval, aval)
@@ -3372,6 +3880,11 @@ void LowerFunctionLLVM::compile() {
                                 ClosureVersion::Property::NoReflection)) {
                             auto code = builder.CreateIntToPtr(
                                 c(nativeTarget->body()), t::voidPtr);
+                            if (auto res = callUnboxed(calli, target, code,
+                                                       args)) {
+                                setVal(i, res);
+                                break;
+                            }
                             llvm::Value* arglist = nodestackPtr();
                             auto rr = withCallFrame(args, [&]() {
                                 return builder.CreateCall(
@@ -3454,7 +3967,7 @@ void LowerFunctionLLVM::compile() {
             }
 
             case Tag::Branch: {
-                auto cond = load(i->arg(0).val(), Representation::Integer);
+                auto cond = load(i->arg(0).val(), Representation::Logical);
                 cond = builder.CreateICmpNE(cond, c(0));
 
                 auto t = bb->trueBranch();
@@ -3494,6 +4007,31 @@ void LowerFunctionLLVM::compile() {
 
                 std::vector<Value*> args;
                 i->eachArg([&](Value* v) { args.push_back(v); });
+
+                if (unboxedEntry) {
+                    // The deopt needs the boxed arguments of the version
+                    auto& sig = *unboxedEntry;
+                    std::vector<llvm::Value*> boxed;
+                    for (size_t a = 0; a < sig.args.size(); ++a) {
+                        auto arg = argument(a);
+                        if (sig.args[a] != Representation::Sexp)
+                            arg = box(arg, sig.argTypes[a]);
+                        boxed.push_back(arg);
+                    }
+                    auto argsPtr = nodestackPtr();
+                    incStack(boxed.size(), false);
+                    stack(boxed);
+                    withCallFrame(args, [&]() {
+                        return call(
+                            NativeBuiltins::get(
+                                NativeBuiltins::Id::deoptUnboxed),
+                            {paramCode(), paramClosure(),
+                             convertToPointer(m, t::i8, true), argsPtr});
+                    });
+                    builder.CreateUnreachable();
+                    break;
+                }
+
                 llvm::CallInst* res;
                 withCallFrame(args, [&]() {
                     res = call(NativeBuiltins::get(NativeBuiltins::Id::deopt),
@@ -3501,7 +4039,9 @@ void LowerFunctionLLVM::compile() {
                                 convertToPointer(m, t::i8, true), paramArgs()});
                     return res;
                 });
-                builder.CreateUnreachable();
+                // Only returns with the result of a deoptless continuation
+                exitBlocks.push_back(builder.GetInsertBlock());
+                builder.CreateRet(res);
                 break;
             }
 
@@ -3661,6 +4201,10 @@ void LowerFunctionLLVM::compile() {
                              BinopKind::NE);
                 break;
 
+            case Tag::Elementwise:
+                compileElementwise(i);
+                break;
+
             case Tag::Minus: {
                 compileUnop(
                     i, [&](llvm::Value* a) { return builder.CreateNeg(a); },
@@ -3696,6 +4240,21 @@ void LowerFunctionLLVM::compile() {
                     break;
                 }
 
+                if (argumentRep == Representation::Logical) {
+                    // The argument is TRUE, FALSE or NA, thus no branch is
+                    // needed to keep NA
+                    auto a = load(argument, argumentRep);
+                    llvm::Value* res = builder.CreateXor(a, c(1));
+                    if (argument->type.maybeNAOrNaN())
+                        res = builder.CreateSelect(
+                            builder.CreateICmpEQ(a, c(NA_LOGICAL)),
+                            c(NA_LOGICAL), res);
+                    if (resultRep == Representation::Sexp)
+                        res = boxLgl(res);
+                    setVal(i, res);
+                    break;
+                }
+
                 auto done =
                     BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
                 auto isNa =
@@ -4036,8 +4595,8 @@ void LowerFunctionLLVM::compile() {
                         call(NativeBuiltins::get(NativeBuiltins::Id::binopEnv),
                              {loadSxp(a), loadSxp(b), e, c(i->srcIdx),
                               c((int)BinopKind::COLON)});
-                } else if (Representation::Of(a) == Representation::Integer &&
-                           Representation::Of(b) == Representation::Integer) {
+                } else if (Representation::Of(a).isIntLike() &&
+                           Representation::Of(b).isIntLike()) {
                     res = call(NativeBuiltins::get(NativeBuiltins::Id::colon),
                                {load(a), load(b)});
                 } else {
@@ -4050,7 +4609,9 @@ void LowerFunctionLLVM::compile() {
             }
 
             case Tag::Return: {
-                auto res = loadSxp(Return::Cast(i)->arg<0>().val());
+                auto val = Return::Cast(i)->arg<0>().val();
+                auto res = unboxedEntry ? load(val, unboxedEntry->result)
+                                        : loadSxp(val);
                 exitBlocks.push_back(builder.GetInsertBlock());
                 builder.CreateRet(res);
                 break;
@@ -4131,7 +4692,7 @@ void LowerFunctionLLVM::compile() {
             }
 
             case Tag::IsType: {
-                assert(Representation::Of(i) == Representation::Integer);
+                assert(Representation::Of(i) == Representation::Logical);
 
                 auto t = IsType::Cast(i);
                 auto arg = i->arg(0).val();
@@ -4210,7 +4771,7 @@ void LowerFunctionLLVM::compile() {
             }
 
             case Tag::Is: {
-                assert(Representation::Of(i) == Representation::Integer);
+                assert(Representation::Of(i) == Representation::Logical);
                 auto is = Is::Cast(i);
                 auto arg = i->arg(0).val();
                 llvm::Value* res;
@@ -4268,8 +4829,7 @@ void LowerFunctionLLVM::compile() {
                     assert(i->type.isA(RType::integer) ||
                            i->type.isA(RType::logical) ||
                            i->type.isA(RType::real));
-                    assert(Representation::Of(i) == Representation::Integer ||
-                           Representation::Of(i) == Representation::Real);
+                    assert(Representation::Of(i) == Representation::Logical);
 
                     bool matchInt =
                         (is->typecheck == BC::RirTypecheck::isINTSXP) &&
@@ -4290,11 +4850,18 @@ void LowerFunctionLLVM::compile() {
             }
 
             case Tag::CheckTrueFalse: {
-                assert(Representation::Of(i) == Representation::Integer);
+                assert(Representation::Of(i) == Representation::Logical);
 
                 auto arg = i->arg(0).val();
                 llvm::Value* res;
 
+                if (Representation::Of(arg) == Representation::Logical &&
+                    !arg->type.maybeNAOrNaN()) {
+                    // Already TRUE or FALSE
+                    setVal(i, load(arg));
+                    break;
+                }
+
                 if (Representation::Of(arg) == Representation::Sexp) {
                     auto a = loadSxp(arg);
                     res = call(
@@ -4314,7 +4881,7 @@ void LowerFunctionLLVM::compile() {
                         res = builder.CreateFCmpUNE(c(0.0), narg);
                         builder.CreateBr(done);
                     } else {
-                        auto narg = load(arg, Representation::Integer);
+                        auto narg = load(arg, r);
                         nacheck(narg, arg->type, isNa);
                         res = builder.CreateICmpNE(c(0), narg);
                         builder.CreateBr(done);
@@ -4339,10 +4906,12 @@ void LowerFunctionLLVM::compile() {
                 auto r1 = Representation::Of(arg);
                 auto r2 = Representation::Of(i);
 
-                assert(r2 == Representation::Integer);
+                assert(r2 == Representation::Logical);
 
                 llvm::Value* res;
-                if (r1 == Representation::Sexp) {
+                if (r1 == Representation::Logical) {
+                    res = load(arg);
+                } else if (r1 == Representation::Sexp) {
                     res = call(
                         NativeBuiltins::get(NativeBuiltins::Id::asLogicalBlt),
                         {loadSxp(arg)});
@@ -4375,15 +4944,12 @@ void LowerFunctionLLVM::compile() {
                 } else {
                     assert(r1 == Representation::Integer);
                     res = load(arg);
-                    if (!arg->type.isA(RType::logical)) {
-                        res = builder.CreateSelect(
-                            builder.CreateICmpEQ(res, c(NA_INTEGER)),
-                            c(NA_LOGICAL),
-                            builder.CreateSelect(
-                                builder.CreateICmpEQ(res, c(0)),
-                                constant(R_FalseValue, t::Int),
-                                constant(R_TrueValue, t::Int)));
-                    }
+                    res = builder.CreateSelect(
+                        builder.CreateICmpEQ(res, c(NA_INTEGER)),
+                        c(NA_LOGICAL),
+                        builder.CreateSelect(builder.CreateICmpEQ(res, c(0)),
+                                             constant(R_FalseValue, t::Int),
+                                             constant(R_TrueValue, t::Int)));
                 }
 
                 setVal(i, res);
@@ -4555,9 +5121,23 @@ void LowerFunctionLLVM::compile() {
                     builder.SetInsertPoint(done);
                     res = phi();
                 } else if (i->env() == Env::global()) {
-                    res = call(
-                        NativeBuiltins::get(NativeBuiltins::Id::ldvarGlobal),
-                        {constant(varName, t::SEXP)});
+                    // While GNU R knows that the lookup resolves to base the
+                    // value is in the symbol, see GlobalCells
+                    auto sym = constant(varName, t::SEXP);
+                    auto sxpinfo = builder.CreateLoad(
+                        builder.CreateBitCast(sxpinfoPtr(sym), t::i64ptr));
+                    static auto baseCachedMask =
+                        (unsigned long)BASE_SYM_CACHED_MASK << (TYPE_BITS + 3);
+                    auto baseCached = builder.CreateICmpNE(
+                        builder.CreateAnd(sxpinfo, c(baseCachedMask)),
+                        c(0, 64));
+                    res = createSelect2(
+                        baseCached, [&]() { return cdr(sym); },
+                        [&]() {
+                            return call(NativeBuiltins::get(
+                                            NativeBuiltins::Id::ldvarGlobal),
+                                        {sym});
+                        });
                 } else {
                     if (needsLdVarForUpdate.count(i)) {
                         res = call(
@@ -4639,8 +5219,9 @@ void LowerFunctionLLVM::compile() {
                         }
                     }
 
-                    llvm::Value* index =
-                        computeAndCheckIndex(extract->idx(), vector, fallback);
+                    llvm::Value* index = computeAndCheckIndex(
+                        extract->idx(), vector, fallback, nullptr,
+                        indexRange.inBounds(extract));
                     auto res0 =
                         extract->vec()->type.isScalar()
                             ? vector
@@ -4783,8 +5364,9 @@ void LowerFunctionLLVM::compile() {
                         builder.SetInsertPoint(hit2);
                     }
 
-                    llvm::Value* index =
-                        computeAndCheckIndex(extract->idx(), vector, fallback);
+                    llvm::Value* index = computeAndCheckIndex(
+                        extract->idx(), vector, fallback, nullptr,
+                        indexRange.inBounds(extract));
                     auto res0 =
                         extract->vec()->type.isScalar()
                             ? vector
@@ -5161,8 +5743,9 @@ void LowerFunctionLLVM::compile() {
                         vector = cloneIfShared(vector);
                     }
 
-                    llvm::Value* index = computeAndCheckIndex(subAssign->idx(),
-                                                              vector, fallback);
+                    llvm::Value* index = computeAndCheckIndex(
+                        subAssign->idx(), vector, fallback, nullptr,
+                        indexRange.inBounds(subAssign));
 
                     auto val = load(subAssign->val());
                     if (Representation::Of(i) == Representation::Sexp) {
@@ -5237,8 +5820,9 @@ void LowerFunctionLLVM::compile() {
                         vector = cloneIfShared(vector);
                     }
 
-                    llvm::Value* index = computeAndCheckIndex(subAssign->idx(),
-                                                              vector, fallback);
+                    llvm::Value* index = computeAndCheckIndex(
+                        subAssign->idx(), vector, fallback, nullptr,
+                        indexRange.inBounds(subAssign));
 
                     auto val = load(subAssign->val());
                     if (Representation::Of(i) == Representation::Sexp) {
@@ -5517,7 +6101,7 @@ void LowerFunctionLLVM::compile() {
             }
 
             case Tag::Missing: {
-                assert(Representation::Of(i) == Representation::Integer);
+                assert(Representation::Of(i) == Representation::Logical);
                 auto missing = Missing::Cast(i);
                 setVal(i,
                        call(NativeBuiltins::get(NativeBuiltins::Id::isMissing),
@@ -5562,7 +6146,7 @@ void LowerFunctionLLVM::compile() {
                         auto ld = builder.CreateFPToSI(load(b), t::i64);
                         return builder.CreateICmpNE(ld, c(INT_MAX, 64));
                     }
-                    assert(Representation::Of(b) == Representation::Integer);
+                    assert(Representation::Of(b).isIntLike());
                     return builder.CreateICmpNE(load(b), c(INT_MAX));
                 };
 
@@ -2,6 +2,7 @@
 #define PIR_COMPILER_LOWER_FUNCTION_LLVM_H
 
 #include "R/Protect.h"
+#include "compiler/analysis/index_range.h"
 #include "compiler/analysis/liveness.h"
 #include "compiler/analysis/reference_count.h"
 #include "compiler/native/builtins.h"
@@ -24,6 +25,7 @@ namespace pir {
 
 typedef std::unordered_map<Code*, std::pair<unsigned, MkArg*>> PromMap;
 struct Representation;
+struct UnboxedSignature;
 class LowerFunctionLLVM {
 
     std::string name;
@@ -32,10 +34,13 @@ class LowerFunctionLLVM {
     BB* currentBB = nullptr;
     const PromMap& promMap;
     const NeedsRefcountAdjustment& refcount;
-    const std::unordered_set<Instruction*>& needsLdVarForUpdate;
+    const ArenaSet<Instruction*>& needsLdVarForUpdate;
+    // If set, incremented on every loop iteration (see PIR_LLVM_TIERING)
+    unsigned* loopCounter;
     llvm::IRBuilder<> builder;
     llvm::MDBuilder MDB;
     LivenessIntervals liveness;
+    IndexRangeAnalysis indexRange;
     size_t numLocals;
     size_t numTemps;
     size_t maxTemps;
@@ -65,6 +70,7 @@ class LowerFunctionLLVM {
 
     PirJitLLVM::GetModule getModule;
     PirJitLLVM::GetFunction getFunction;
+    PirJitLLVM::GetUnboxedFunction getUnboxedFunction;
 
     PirJitLLVM::DebugInfo* DI;
     llvm::DIBuilder* DIB;
@@ -74,24 +80,30 @@ class LowerFunctionLLVM {
   public:
     PirTypeFeedback* pirTypeFeedback = nullptr;
     llvm::Function* fun;
+    // If set, compile the unboxed entry of the version instead
+    const UnboxedSignature* unboxedEntry = nullptr;
     MkEnv* myPromenv = nullptr;
 
     LowerFunctionLLVM(
         const std::string& name, Code* code, const PromMap& promMap,
         const NeedsRefcountAdjustment& refcount,
-        const std::unordered_set<Instruction*>& needsLdVarForUpdate,
-        PirJitLLVM::Declare declare, const PirJitLLVM::GetModule& getModule,
-        const PirJitLLVM::GetFunction& getFunction, PirJitLLVM::DebugInfo* DI,
-        llvm::DIBuilder* DIB)
+        const ArenaSet<Instruction*>& needsLdVarForUpdate,
+        unsigned* loopCounter, PirJitLLVM::Declare declare,
+        const PirJitLLVM::GetModule& getModule,
+        const PirJitLLVM::GetFunction& getFunction,
+        const PirJitLLVM::GetUnboxedFunction& getUnboxedFunction,
+        PirJitLLVM::DebugInfo* DI, llvm::DIBuilder* DIB)
         : code(code), promMap(promMap), refcount(refcount),
-          needsLdVarForUpdate(needsLdVarForUpdate),
+          needsLdVarForUpdate(needsLdVarForUpdate), loopCounter(loopCounter),
           builder(PirJitLLVM::getContext()), MDB(PirJitLLVM::getContext()),
-          liveness(code, code->nextBBId), numLocals(0), numTemps(0),
-          maxTemps(0), branchAlwaysTrue(MDB.createBranchWeights(100000000, 1)),
+          liveness(code, code->nextBBId), indexRange(code), numLocals(0),
+          numTemps(0), maxTemps(0),
+          branchAlwaysTrue(MDB.createBranchWeights(100000000, 1)),
           branchAlwaysFalse(MDB.createBranchWeights(1, 100000000)),
           branchMostlyTrue(MDB.createBranchWeights(1000, 1)),
           branchMostlyFalse(MDB.createBranchWeights(1, 1000)),
-          getModule(getModule), getFunction(getFunction), DI(DI), DIB(DIB) {
+          getModule(getModule), getFunction(getFunction),
+          getUnboxedFunction(getUnboxedFunction), DI(DI), DIB(DIB) {
 
         fun = declare(code, name, t::nativeFunction);
 
@@ -236,6 +248,11 @@ class LowerFunctionLLVM {
     void setLocal(size_t i, llvm::Value* v);
     void incStack(int i, bool zero);
     void decStack(int i);
+    // Calls the unboxed entry of target, if it has one that fits the call.
+    // Returns nullptr otherwise.
+    llvm::Value* callUnboxed(StaticCall* calli, ClosureVersion* target,
+                             llvm::Value* code,
+                             const std::vector<Value*>& args);
     llvm::Value* withCallFrame(const std::vector<Value*>& args,
                                const std::function<llvm::Value*()>& theCall,
                                bool pop = true);
@@ -394,7 +411,8 @@ class LowerFunctionLLVM {
 
     llvm::Value* computeAndCheckIndex(Value* index, llvm::Value* vector,
                                       llvm::BasicBlock* fallback,
-                                      llvm::Value* max = nullptr);
+                                      llvm::Value* max = nullptr,
+                                      bool inBounds = false);
     bool compileDotcall(Instruction* i,
                         const std::function<llvm::Value*()>& callee,
                         const std::function<SEXP(size_t)>& names);
@@ -433,6 +451,14 @@ class LowerFunctionLLVM {
             intInsert,
         const std::function<llvm::Value*(llvm::Value*, llvm::Value*)>& fpInsert,
         BinopKind kind, bool testNa = true);
+    // Elementwise arithmetic and comparisons on attribute free int and real
+    // vectors as an inline loop. Returns false if the types do not allow it.
+    bool compileVectorBinop(Instruction* i, Value* lhs, Value* rhs,
+                            BinopKind kind);
+    void compileElementwise(Instruction* i);
+    // One element of an elementwise arithmetic or comparison. Integer
+    // operands are converted to double, unless both are compared.
+    llvm::Value* elementwiseOp(BinopKind kind, llvm::Value* a, llvm::Value* b);
 
     void compile();
 
@@ -7,6 +7,8 @@
 #include "llvm/Analysis/ScopedNoAliasAA.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Analysis/TypeBasedAliasAnalysis.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
@@ -17,6 +19,8 @@
 #include "llvm/Transforms/Utils.h"
 #include "llvm/Transforms/Vectorize.h"
 
+#include <cstring>
+
 namespace rir {
 namespace pir {
 
@@ -70,11 +74,24 @@ static llvm::RegisterPass<NooptCold> X("noopt-cold",
                                        false /* Only looks at CFG */,
                                        false /* Analysis Pass */);
 
+static unsigned clampLevel(unsigned level) {
+    return level > PassScheduleLLVM::MAX_OPT_LEVEL
+               ? PassScheduleLLVM::MAX_OPT_LEVEL
+               : level;
+}
+
 llvm::Expected<llvm::orc::ThreadSafeModule> PassScheduleLLVM::
 operator()(llvm::orc::ThreadSafeModule TSM,
            llvm::orc::MaterializationResponsibility& R) {
     TSM.withModuleDo([this](llvm::Module& M) {
-        PM->run(M);
+        unsigned level = Parameter::PIR_LLVM_OPT_LEVEL;
+        if (auto flag = llvm::mdconst::extract_or_null<llvm::ConstantInt>(
+                M.getModuleFlag(OPT_LEVEL_FLAG)))
+            level = flag->getZExtValue();
+        level = clampLevel(level);
+        if (!PM[level])
+            PM[level] = create(level);
+        PM[level]->run(M);
 #ifdef ENABLE_SLOWASSERT
         for (auto& F : M) {
             verifyFunction(F);
@@ -85,12 +102,23 @@ operator()(llvm::orc::ThreadSafeModule TSM,
 }
 
 PassScheduleLLVM::PassScheduleLLVM() {
-    using namespace llvm;
+    // Set up eagerly, the schedule might run on the background compilation
+    // thread
+    auto level = clampLevel(Parameter::PIR_LLVM_OPT_LEVEL);
+    if (!PM[level])
+        PM[level] = create(level);
+    if (Parameter::PIR_LLVM_TIERING) {
+        auto tier1 = clampLevel(Parameter::PIR_LLVM_TIER1_OPT_LEVEL);
+        if (!PM[tier1])
+            PM[tier1] = create(tier1);
+    }
+}
 
-    if (PM.get())
-        return;
+std::unique_ptr<llvm::legacy::PassManager>
+PassScheduleLLVM::create(unsigned level) {
+    using namespace llvm;
 
-    PM.reset(new llvm::legacy::PassManager);
+    auto PM = std::make_unique<llvm::legacy::PassManager>();
 
     PM->add(createHotColdSplittingPass());
     PM->add(new NooptCold());
@@ -105,7 +133,7 @@ PassScheduleLLVM::PassScheduleLLVM() {
     PM->add(createDeadInstEliminationPass());
     PM->add(createCFGSimplificationPass());
 
-    if (rir::pir::Parameter::PIR_LLVM_OPT_LEVEL > 1) {
+    if (level > 1) {
         PM->add(createCFLSteensAAWrapperPass());
         PM->add(createTypeBasedAAWrapperPass());
         PM->add(createScopedNoAliasAAWrapperPass());
@@ -115,7 +143,7 @@ PassScheduleLLVM::PassScheduleLLVM() {
 
     PM->add(createSROAPass());
     PM->add(createEarlyCSEPass(true));
-    if (rir::pir::Parameter::PIR_LLVM_OPT_LEVEL > 0) {
+    if (level > 0) {
         PM->add(createPromoteMemoryToRegisterPass());
         PM->add(createConstantPropagationPass());
     }
@@ -126,8 +154,8 @@ PassScheduleLLVM::PassScheduleLLVM() {
     PM->add(createInstructionCombiningPass());
     PM->add(createCFGSimplificationPass());
 
-    if (rir::pir::Parameter::PIR_LLVM_OPT_LEVEL < 2)
-        return;
+    if (level < 2)
+        return PM;
 
     PM->add(createSROAPass());
     PM->add(createInstSimplifyLegacyPass());
@@ -190,12 +218,25 @@ PassScheduleLLVM::PassScheduleLLVM() {
     PM->add(createAggressiveDCEPass());
 
     PM->add(createDivRemPairsPass());
+    return PM;
 }
 
-std::unique_ptr<llvm::legacy::PassManager> PassScheduleLLVM::PM = nullptr;
+std::unique_ptr<llvm::legacy::PassManager>
+    PassScheduleLLVM::PM[PassScheduleLLVM::MAX_OPT_LEVEL + 1];
 
 unsigned Parameter::PIR_LLVM_OPT_LEVEL =
     getenv("PIR_LLVM_OPT_LEVEL") ? atoi(getenv("PIR_LLVM_OPT_LEVEL")) : 2;
 
+bool Parameter::PIR_LLVM_TIERING =
+    getenv("PIR_LLVM_TIERING") &&
+    0 == strncmp("1", getenv("PIR_LLVM_TIERING"), 1);
+unsigned Parameter::PIR_LLVM_TIER1_OPT_LEVEL =
+    getenv("PIR_LLVM_TIER1_OPT_LEVEL") ? atoi(getenv("PIR_LLVM_TIER1_OPT_LEVEL"))
+                                       : 0;
+unsigned Parameter::PIR_LLVM_TIER2_THRESHOLD =
+    getenv("PIR_LLVM_TIER2_THRESHOLD")
+        ? atoi(getenv("PIR_LLVM_TIER2_THRESHOLD"))
+        : 5000;
+
 } // namespace pir
 } // namespace rir
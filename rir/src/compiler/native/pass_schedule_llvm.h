@@ -20,8 +20,14 @@ class PassScheduleLLVM {
 
     PassScheduleLLVM();
 
+    // Name of the module flag selecting the optimization level. Modules
+    // without it are optimized at PIR_LLVM_OPT_LEVEL.
+    static constexpr const char* OPT_LEVEL_FLAG = "rir.opt.level";
+    static constexpr unsigned MAX_OPT_LEVEL = 2;
+
   private:
-    static std::unique_ptr<llvm::legacy::PassManager> PM;
+    static std::unique_ptr<llvm::legacy::PassManager> create(unsigned level);
+    static std::unique_ptr<llvm::legacy::PassManager> PM[MAX_OPT_LEVEL + 1];
 };
 
 } // namespace pir
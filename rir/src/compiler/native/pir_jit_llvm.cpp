@@ -1,11 +1,16 @@
 #include "pir_jit_llvm.h"
 #include "api.h"
+#include "compiler/native/background_compilation.h"
 #include "compiler/native/builtins.h"
 #include "compiler/native/lower_function_llvm.h"
 #include "compiler/native/pass_schedule_llvm.h"
 #include "compiler/native/types_llvm.h"
+#include "compiler/parameter.h"
+#include "runtime/DispatchTable.h"
 #include "utils/filesystem.h"
 
+#include <chrono>
+
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "llvm/ExecutionEngine/Orc/Mangling.h"
@@ -36,6 +41,47 @@ llvm::orc::ThreadSafeContext TSC;
 
 std::string dbgFolder;
 
+// Native code emitted by the current thread, reported by rir.jitStats
+thread_local size_t emittedCodeBytes = 0;
+
+class CountingMemoryManager : public llvm::SectionMemoryManager {
+    uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment,
+                                 unsigned id,
+                                 llvm::StringRef name) override {
+        emittedCodeBytes += size;
+        return SectionMemoryManager::allocateCodeSection(size, alignment, id,
+                                                         name);
+    }
+};
+
+// Adds the module and looks up the symbols. Returns the time it took in
+// seconds and the size of the emitted code.
+std::pair<double, size_t>
+addAndLookup(llvm::orc::ThreadSafeModule module,
+             const std::vector<std::string>& symbols,
+             std::vector<NativeCode>& addresses) {
+    auto start = std::chrono::steady_clock::now();
+    auto bytes = emittedCodeBytes;
+    ExitOnErr(JIT->addIRModule(std::move(module)));
+    // Code is emitted lazily on the first lookup
+    for (auto& name : symbols) {
+        auto symbol = ExitOnErr(JIT->lookup(name));
+        addresses.push_back((NativeCode)symbol.getAddress());
+    }
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    return {time.count(), emittedCodeBytes - bytes};
+}
+
+void setStats(
+    const std::vector<std::pair<DispatchTable*, rir::Function*>>& installs,
+    std::pair<double, size_t> stats) {
+    for (auto& i : installs) {
+        i.second->stats.llvmTime = stats.first;
+        i.second->stats.nativeBytes = stats.second;
+    }
+}
+
 } // namespace
 
 void PirJitLLVM::DebugInfo::addCode(Code* c) {
@@ -293,7 +339,8 @@ void PirJitLLVM::DebugInfo::clearLocation(llvm::IRBuilder<>& builder) {
     builder.SetCurrentDebugLocation(llvm::DebugLoc());
 }
 
-PirJitLLVM::PirJitLLVM(const std::string& name) : name(name) {
+PirJitLLVM::PirJitLLVM(const std::string& name, bool background, bool tier1)
+    : name(name), background(background), tier1(tier1) {
     if (!initialized)
         initializeLLVM();
 }
@@ -305,6 +352,7 @@ PirJitLLVM::~PirJitLLVM() {
     if (M) {
         // Should this happen before finalizeAndFixup or after?
         if (LLVMDebugInfo()) {
+            auto lock = TSC.getLock();
             DIB->finalize();
         }
         finalizeAndFixup();
@@ -312,26 +360,80 @@ PirJitLLVM::~PirJitLLVM() {
     }
 }
 
+void PirJitLLVM::install(DispatchTable* table, rir::Function* fun) {
+    installs.emplace_back(table, fun);
+    if (!background)
+        table->insert(fun);
+}
+
 void PirJitLLVM::finalizeAndFixup() {
-    // TODO: maybe later have TSM from the start and use locking
-    //       to allow concurrent compilation?
     auto TSM = llvm::orc::ThreadSafeModule(std::move(M), TSC);
-    ExitOnErr(JIT->addIRModule(std::move(TSM)));
-    for (auto& fix : jitFixup) {
-        auto symbol = ExitOnErr(JIT->lookup(fix.second.second));
-        void* native = (void*)symbol.getAddress();
-        fix.second.first->nativeCode = (NativeCode)native;
+
+    if (background) {
+        // The worker only gets to see LLVM data structures. The rir::Code
+        // objects are patched on the main thread when the job is installed.
+        BackgroundCompilation::Job job;
+        std::vector<rir::Code*> targets;
+        auto symbols = std::make_shared<std::vector<std::string>>();
+        auto addresses = std::make_shared<std::vector<NativeCode>>();
+        for (auto& fix : jitFixup) {
+            targets.push_back(fix.second.first);
+            symbols->push_back(fix.second.second);
+            job.preserve.push_back(fix.second.first->container());
+        }
+        for (auto& i : installs) {
+            job.preserve.push_back(i.first->container());
+            job.preserve.push_back(i.second->container());
+        }
+        if (!installs.empty())
+            job.table = installs.front().first;
+
+        auto module =
+            std::make_shared<llvm::orc::ThreadSafeModule>(std::move(TSM));
+        auto stats = std::make_shared<std::pair<double, size_t>>();
+        job.compile = [module, symbols, addresses, stats]() {
+            *stats = addAndLookup(std::move(*module), *symbols, *addresses);
+        };
+        auto installs = this->installs;
+        job.install = [targets, addresses, installs, stats]() {
+            assert(targets.size() == addresses->size());
+            for (size_t i = 0; i < targets.size(); ++i)
+                targets[i]->nativeCode = addresses->at(i);
+            setStats(installs, *stats);
+            for (auto& i : installs)
+                i.first->insert(i.second);
+        };
+        BackgroundCompilation::submit(std::move(job));
+        return;
     }
+
+    std::vector<std::string> symbols;
+    std::vector<NativeCode> addresses;
+    for (auto& fix : jitFixup)
+        symbols.push_back(fix.second.second);
+    auto stats = addAndLookup(std::move(TSM), symbols, addresses);
+    size_t i = 0;
+    for (auto& fix : jitFixup)
+        fix.second.first->nativeCode = addresses.at(i++);
+    setStats(installs, stats);
 }
 
 void PirJitLLVM::compile(
     rir::Code* target, Code* code, const PromMap& promMap,
     const NeedsRefcountAdjustment& refcount,
-    const std::unordered_set<Instruction*>& needsLdVarForUpdate,
+    const ArenaSet<Instruction*>& needsLdVarForUpdate,
     ClosureStreamLogger& log) {
 
+    // The worker thread might be optimizing another module in the shared
+    // context concurrently
+    auto lock = TSC.getLock();
+
     if (!M.get()) {
         M = std::make_unique<llvm::Module>("", *TSC.getContext());
+        if (tier1)
+            M->addModuleFlag(llvm::Module::Override,
+                             PassScheduleLLVM::OPT_LEVEL_FLAG,
+                             Parameter::PIR_LLVM_TIER1_OPT_LEVEL);
 
         if (LLVMDebugInfo()) {
 
@@ -367,8 +469,39 @@ void PirJitLLVM::compile(
 
     std::string mangledName = JIT->mangle(makeName(code));
 
+    // Loops are only counted in the function body, that is where the tier up
+    // heuristic looks
+    unsigned* loopCounter =
+        tier1 && ClosureVersion::Cast(code) ? &target->loopCount : nullptr;
+
+    // Declared upfront, such that the body can call itself unboxed
+    auto cls = ClosureVersion::Cast(code);
+    if (cls && !LLVMDebugInfo()) {
+        UnboxedSignature sig;
+        if (UnboxedSignature::Of(cls, sig)) {
+            auto f = llvm::Function::Create(
+                sig.type(), llvm::Function::ExternalLinkage,
+                JIT->mangle(makeName(code) + "_unboxed"), *M);
+            unboxedFuns.emplace(code, std::make_pair(f, sig));
+        }
+    }
+    PirJitLLVM::GetUnboxedFunction getUnboxedFunction =
+        [&](Code* c) -> std::pair<llvm::Function*, const UnboxedSignature*> {
+        auto r = unboxedFuns.find(c);
+        if (r != unboxedFuns.end())
+            return {r->second.first, &r->second.second};
+        return {nullptr, nullptr};
+    };
+    PirJitLLVM::GetModule getModule = [&]() -> llvm::Module& { return *M; };
+    PirJitLLVM::GetFunction getFunction = [&](Code* c) -> llvm::Function* {
+        auto r = funs.find(c);
+        if (r != funs.end())
+            return r->second;
+        return nullptr;
+    };
+
     LowerFunctionLLVM funCompiler(
-        mangledName, code, promMap, refcount, needsLdVarForUpdate,
+        mangledName, code, promMap, refcount, needsLdVarForUpdate, loopCounter,
         // declare
         [&](Code* c, const std::string& name, llvm::FunctionType* signature) {
             assert(!funs.count(c));
@@ -389,16 +522,7 @@ void PirJitLLVM::compile(
             funs[c] = f;
             return f;
         },
-        // getModule
-        [&]() -> llvm::Module& { return *M; },
-        // getFunction
-        [&](Code* c) -> llvm::Function* {
-            auto r = funs.find(c);
-            if (r != funs.end())
-                return r->second;
-            return nullptr;
-        },
-        DI.get(), DIB.get());
+        getModule, getFunction, getUnboxedFunction, DI.get(), DIB.get());
 
     llvm::DISubprogram* SP = nullptr;
     if (LLVMDebugInfo()) {
@@ -421,6 +545,22 @@ void PirJitLLVM::compile(
     llvm::verifyFunction(*funCompiler.fun);
     assert(jitFixup.count(code) == 0);
 
+    // The unboxed entry is only called directly from native code in this
+    // module, thus it needs no fixup
+    auto unboxed = unboxedFuns.find(code);
+    if (unboxed != unboxedFuns.end()) {
+        LowerFunctionLLVM unboxedCompiler(
+            mangledName, code, promMap, refcount, needsLdVarForUpdate,
+            loopCounter,
+            [&](Code*, const std::string&, llvm::FunctionType*) {
+                return unboxed->second.first;
+            },
+            getModule, getFunction, getUnboxedFunction, nullptr, nullptr);
+        unboxedCompiler.unboxedEntry = &unboxed->second.second;
+        unboxedCompiler.compile();
+        llvm::verifyFunction(*unboxedCompiler.fun);
+    }
+
     if (LLVMDebugInfo()) {
         DI->LexicalBlocks.pop_back();
         DIB->finalizeSubprogram(SP);
@@ -477,7 +617,7 @@ void PirJitLLVM::initializeLLVM() {
             .setObjectLinkingLayerCreator(
                 [&](ExecutionSession& ES, const Triple& TT) {
                     auto GetMemMgr = []() {
-                        return std::make_unique<SectionMemoryManager>();
+                        return std::make_unique<CountingMemoryManager>();
                     };
                     auto ObjLinkingLayer =
                         std::make_unique<RTDyldObjectLinkingLayer>(
@@ -511,6 +651,12 @@ void PirJitLLVM::initializeLLVM() {
     initializeTypes(*TSC.getContext());
     NativeBuiltins::initializeBuiltins();
 
+    // Compilation jobs of the background worker must be stopped before the
+    // JIT is torn down
+    static struct StopBackgroundCompilation {
+        ~StopBackgroundCompilation() { BackgroundCompilation::shutdown(); }
+    } stopBackgroundCompilation;
+
     // Initialize a JITDylib for builtins - these are implemented in C++ and
     // compiled when building Ř, we need to define symbols for them and
     // initialize these to the static addresses of each builtin; they are in
@@ -3,6 +3,7 @@
 
 #include "compiler/log/stream_logger.h"
 #include "compiler/native/builtins.h"
+#include "compiler/native/representation_llvm.h"
 #include "compiler/pir/bb.h"
 #include "compiler/pir/closure_version.h"
 #include "compiler/pir/instruction.h"
@@ -24,6 +25,8 @@
 namespace rir {
 
 struct Code;
+struct DispatchTable;
+struct Function;
 
 namespace pir {
 
@@ -40,18 +43,28 @@ using PromMap = std::unordered_map<Code*, std::pair<unsigned, MkArg*>>;
 // addresses for PIR builtins.
 class PirJitLLVM {
   public:
-    explicit PirJitLLVM(const std::string& name);
+    // tier1: compile cheaply at PIR_LLVM_TIER1_OPT_LEVEL and count loop
+    // iterations, such that hot code can be recompiled later
+    PirJitLLVM(const std::string& name, bool background, bool tier1);
     PirJitLLVM(const PirJitLLVM&) = delete;
     PirJitLLVM(PirJitLLVM&&) = delete;
     ~PirJitLLVM();
 
     void compile(rir::Code* target, Code* code, const PromMap& m,
                  const NeedsRefcountAdjustment& refcount,
-                 const std::unordered_set<Instruction*>& needsLdVarForUpdate,
+                 const ArenaSet<Instruction*>& needsLdVarForUpdate,
                  ClosureStreamLogger& log);
 
+    // Insert fun into table once its native code is available. In background
+    // mode this is deferred until the worker thread finished compiling the
+    // module, otherwise it happens immediately.
+    void install(DispatchTable* table, rir::Function* fun);
+
     using GetModule = std::function<llvm::Module&()>;
     using GetFunction = std::function<llvm::Function*(Code*)>;
+    using GetUnboxedFunction =
+        std::function<std::pair<llvm::Function*, const UnboxedSignature*>(
+            Code*)>;
     using GetBuiltin = std::function<llvm::Function*(const NativeBuiltin&)>;
     using Declare = std::function<llvm::Function*(Code*, const std::string&,
                                                   llvm::FunctionType*)>;
@@ -60,12 +73,18 @@ class PirJitLLVM {
 
   private:
     std::string name;
+    bool background;
+    bool tier1;
+    std::vector<std::pair<DispatchTable*, rir::Function*>> installs;
 
     // Initialized on the first call to compile
     std::unique_ptr<llvm::Module> M;
 
     // Directory of all functions and builtins
     std::unordered_map<Code*, llvm::Function*> funs;
+    // Unboxed entries of the closure versions which have one
+    std::unordered_map<Code*, std::pair<llvm::Function*, UnboxedSignature>>
+        unboxedFuns;
 
     // We prepend `rsh_` to all user functions, as a mechanism to
     // differentiate them from builtins. We also append `.N` to all
@@ -1,5 +1,7 @@
 #include "representation_llvm.h"
+#include "compiler/parameter.h"
 #include "compiler/pir/pir_impl.h"
+#include "compiler/util/visitor.h"
 
 namespace rir {
 namespace pir {
@@ -10,7 +12,7 @@ Representation Representation::Of(PirType t) {
     if (!t.maybeMissing() && !t.maybePromiseWrapped()) {
         if (t.isA(PirType(RType::logical).simpleScalar().notObject())) {
             assert(t.unboxable());
-            return Representation::Integer;
+            return Representation::Logical;
         }
         if (t.isA(PirType(RType::integer).simpleScalar().notObject())) {
             assert(t.unboxable());
@@ -27,5 +29,67 @@ Representation Representation::Of(PirType t) {
 
 Representation Representation::Of(Value* v) { return Of(v->type); }
 
+llvm::FunctionType* UnboxedSignature::type() const {
+    std::vector<llvm::Type*> params = {t::voidPtr, t::stackCellPtr, t::SEXP,
+                                       t::SEXP};
+    for (auto a : args)
+        params.push_back(a);
+    auto r = result;
+    return llvm::FunctionType::get(r, params, false);
+}
+
+bool UnboxedSignature::Of(ClosureVersion* cls, UnboxedSignature& sig) {
+    // Without reflection the callee needs no RCNTXT, thus it can be called
+    // directly from native code
+    if (!Parameter::PIR_UNBOXED_CALLS ||
+        !cls->properties.includes(ClosureVersion::Property::NoReflection))
+        return false;
+
+    auto nargs = cls->effectiveNArgs();
+    sig.argTypes = std::vector<PirType>(nargs, PirType::bottom());
+    sig.resultType = PirType::bottom();
+
+    bool ok = true;
+    // Promises load arguments from their own args pointer
+    cls->eachPromise([&](Promise* p) {
+        Visitor::run(p->entry, [&](Instruction* i) {
+            if (LdArg::Cast(i))
+                ok = false;
+        });
+    });
+    bool hasReturn = false;
+    Visitor::run(cls->entry, [&](Instruction* i) {
+        if (auto ld = LdArg::Cast(i)) {
+            if (ld->id < nargs)
+                sig.argTypes[ld->id] = sig.argTypes[ld->id] | ld->type;
+            else
+                ok = false;
+        } else if (auto ret = Return::Cast(i)) {
+            sig.resultType = sig.resultType | ret->arg<0>().val()->type;
+            hasReturn = true;
+        } else if (NonLocalReturn::Cast(i)) {
+            ok = false;
+        }
+    });
+    if (!ok || !hasReturn)
+        return false;
+
+    // Unused arguments are passed boxed
+    bool unboxed = false;
+    sig.args.clear();
+    for (auto& a : sig.argTypes) {
+        if (a == PirType::bottom())
+            a = PirType::any();
+        sig.args.push_back(Representation::Of(a));
+        unboxed = unboxed || sig.args.back() != Representation::Sexp;
+    }
+    sig.result = Representation::Of(sig.resultType);
+    return unboxed || sig.result != Representation::Sexp;
+}
+
+bool Parameter::PIR_UNBOXED_CALLS =
+    !getenv("PIR_UNBOXED_CALLS") ||
+    0 != strncmp("0", getenv("PIR_UNBOXED_CALLS"), 1);
+
 } // namespace pir
 } // namespace rir
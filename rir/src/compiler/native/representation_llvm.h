@@ -4,13 +4,20 @@
 #include "types_llvm.h"
 
 #include "compiler/pir/pir.h"
+#include "compiler/pir/type.h"
+
+#include <vector>
 
 namespace rir {
 namespace pir {
 
 struct Representation {
+    // Logicals are carried in a native int like integers, but their value is
+    // known to be TRUE, FALSE or NA_LOGICAL. Ordered before Integer, such
+    // that merging the two widens to Integer.
     enum Type {
         Bottom,
+        Logical,
         Integer,
         Real,
         Sexp,
@@ -38,6 +45,7 @@ struct Representation {
         switch (t) {
         case Representation::Bottom:
             return t::Void;
+        case Representation::Logical:
         case Representation::Integer:
             return t::Int;
         case Representation::Real:
@@ -55,6 +63,8 @@ struct Representation {
         }
         return false;
     }
+    bool isIntLike() const { return t == Logical || t == Integer; }
+
     bool operator<(const Representation& other) const { return t < other.t; }
     bool operator==(const Representation& other) const { return t == other.t; }
     bool operator!=(const Representation& other) const {
@@ -65,6 +75,23 @@ struct Representation {
     static Representation Of(pir::Value* v);
 };
 
+// Calling convention of the unboxed entry point of a closure version. It takes
+// the same parameters as the boxed entry (with a null args pointer), followed
+// by the arguments. Arguments and result with an int or double representation
+// are passed unboxed, the remaining ones as SEXP.
+struct UnboxedSignature {
+    std::vector<PirType> argTypes;
+    std::vector<Representation> args;
+    PirType resultType = PirType::bottom();
+    Representation result;
+
+    llvm::FunctionType* type() const;
+
+    // Returns false if cls cannot be called without the boxed arguments (or if
+    // nothing would be unboxed)
+    static bool Of(ClosureVersion* cls, UnboxedSignature& sig);
+};
+
 } // namespace pir
 } // namespace rir
 
@@ -2,6 +2,7 @@
 #include "../pir/pir_impl.h"
 #include "../util/visitor.h"
 #include "compiler/analysis/cfg.h"
+#include "compiler/compiler.h"
 #include "compiler/util/bb_transform.h"
 #include "pass_definitions.h"
 
@@ -14,9 +15,9 @@
 namespace rir {
 namespace pir {
 
-bool Cleanup::apply(Compiler&, ClosureVersion* cls, Code* code,
+bool Cleanup::apply(Compiler& cmp, ClosureVersion* cls, Code* code,
                     LogStream&) const {
-    std::unordered_set<size_t> usedProms;
+    ArenaSet<size_t> usedProms(cmp.tables());
     std::unordered_map<BB*, std::unordered_set<Phi*>> usedBB;
     std::deque<Promise*> todoUsedProms;
 
@@ -3,6 +3,7 @@
 #include "R/r.h"
 #include "compiler/analysis/cfg.h"
 #include "compiler/analysis/query.h"
+#include "compiler/compiler.h"
 #include "pass_definitions.h"
 
 #include <unordered_map>
@@ -10,11 +11,11 @@
 namespace rir {
 namespace pir {
 
-bool ElideEnv::apply(Compiler&, ClosureVersion* cls, Code* code,
+bool ElideEnv::apply(Compiler& cmp, ClosureVersion* cls, Code* code,
                      LogStream&) const {
     bool anyChange = false;
-    std::unordered_set<Value*> envNeeded;
-    std::unordered_map<Value*, Value*> envDependency;
+    ArenaSet<Value*> envNeeded(cmp.tables());
+    ArenaMap<Value*, Value*> envDependency(cmp.tables());
 
     Visitor::run(code->entry, [&](BB* bb) {
         for (auto ip = bb->begin(); ip != bb->end(); ++ip) {
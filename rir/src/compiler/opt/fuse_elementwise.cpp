@@ -0,0 +1,159 @@
+#include "../pir/pir_impl.h"
+#include "../util/visitor.h"
+#include "pass_definitions.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace rir {
+namespace pir {
+
+static bool plainVector(Value* v) {
+    return v->type.isA(PirType(RType::real)) ||
+           v->type.isA(PirType(RType::integer));
+}
+
+static bool isRelop(Tag t) {
+    switch (t) {
+    case Tag::Lt:
+    case Tag::Lte:
+    case Tag::Gt:
+    case Tag::Gte:
+    case Tag::Eq:
+    case Tag::Neq:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Arithmetic on plain vectors which produces a real vector, and comparisons
+// producing a logical vector. Integer Add, Sub and Mul can overflow, which
+// needs a warning, thus they are not fusable.
+static bool fusable(Instruction* i, bool root) {
+    switch (i->tag) {
+    case Tag::Add:
+    case Tag::Sub:
+    case Tag::Mul:
+    case Tag::Div:
+        break;
+    default:
+        if (!root || !isRelop(i->tag))
+            return false;
+    }
+    auto lhs = i->arg(0).val();
+    auto rhs = i->arg(1).val();
+    if (!plainVector(lhs) || !plainVector(rhs))
+        return false;
+    if (i->getObservableEffects().contains(Effect::ExecuteCode))
+        return false;
+    if (i->tag == Tag::Add || i->tag == Tag::Sub || i->tag == Tag::Mul)
+        return lhs->type.isA(PirType(RType::real)) ||
+               rhs->type.isA(PirType(RType::real));
+    return true;
+}
+
+bool FuseElementwise::apply(Compiler&, ClosureVersion* cls, Code* code,
+                            LogStream&) const {
+    bool anyChange = false;
+
+    Visitor::run(code->entry, [&](BB* bb) {
+        std::unordered_map<Instruction*, size_t> position;
+        size_t pos = 0;
+        for (auto i : *bb)
+            position[i] = pos++;
+
+        std::unordered_set<Instruction*> fused;
+        std::unordered_map<Instruction*, Elementwise*> replacements;
+        // Visit in reverse, such that the outermost operation of an
+        // expression is seen first and becomes the root
+        for (auto it = bb->rbegin(); it != bb->rend(); ++it) {
+            auto root = *it;
+            if (fused.count(root) || !fusable(root, true) ||
+                root->type.isScalar())
+                continue;
+
+            std::vector<Elementwise::Node> nodes;
+            std::vector<Value*> args;
+            std::unordered_map<Value*, unsigned> leaves;
+            std::vector<Instruction*> inner;
+            Effects effects = root->getObservableEffects();
+
+            std::function<unsigned(Value*)> build = [&](Value* v) -> unsigned {
+                auto i = Instruction::Cast(v);
+                if (i && i->bb() == bb && fusable(i, false) &&
+                    i->env() == root->env() && !fused.count(i) &&
+                    i->hasSingleUse()) {
+                    auto lhs = build(i->arg(0).val());
+                    auto rhs = build(i->arg(1).val());
+                    nodes.push_back({i->tag, lhs, rhs, i->srcIdx});
+                    inner.push_back(i);
+                    effects = effects | i->getObservableEffects();
+                    return nodes.size() - 1;
+                }
+                if (!leaves.count(v)) {
+                    leaves[v] = args.size();
+                    args.push_back(v);
+                }
+                nodes.push_back({Tag::Nop, leaves.at(v), 0, 0});
+                return nodes.size() - 1;
+            };
+            auto lhs = build(root->arg(0).val());
+            auto rhs = build(root->arg(1).val());
+            nodes.push_back({root->tag, lhs, rhs, root->srcIdx});
+
+            // A single operation is handled by the backend directly
+            if (inner.empty())
+                continue;
+            // The fused loop runs over the vector leaves, scalar trees are
+            // left to the scalar lowering
+            if (std::all_of(args.begin(), args.end(), [](Value* a) {
+                    return a->type.isSimpleScalar();
+                }))
+                continue;
+
+            // The inner operations are evaluated at the position of the root.
+            // Their warnings must not move across other effects.
+            size_t first = position.at(root);
+            for (auto i : inner)
+                first = std::min(first, position.at(i));
+            std::unordered_set<Instruction*> tree(inner.begin(), inner.end());
+            bool reorders = false;
+            for (auto i = bb->begin() + first; *i != root; ++i)
+                if (!tree.count(*i) && (*i)->hasStrongEffects())
+                    reorders = true;
+            if (reorders)
+                continue;
+
+            auto res = new Elementwise(root->type, root->env(), effects,
+                                       root->srcIdx);
+            for (auto a : args)
+                res->pushArg(a, a->type);
+            res->nodes = nodes;
+            replacements[root] = res;
+            fused.insert(root);
+            fused.insert(inner.begin(), inner.end());
+        }
+
+        // Insert all fused instructions first, since fused expressions can be
+        // leaves of other fused expressions
+        for (auto r : replacements)
+            bb->insert(bb->atPosition(r.first), r.second);
+        for (auto r : replacements)
+            r.first->replaceUsesWith(r.second);
+        for (auto it = bb->begin(); it != bb->end();) {
+            if (fused.count(*it))
+                it = bb->remove(it);
+            else
+                ++it;
+        }
+        if (!replacements.empty())
+            anyChange = true;
+    });
+
+    return anyChange;
+}
+
+} // namespace pir
+} // namespace rir
@@ -1,4 +1,5 @@
 #include "R/r.h"
+#include "compiler/compiler.h"
 #include "compiler/pir/pir.h"
 #include "compiler/pir/pir_impl.h"
 #include "compiler/util/bb_transform.h"
@@ -10,13 +11,13 @@
 namespace rir {
 namespace pir {
 
-bool GVN::apply(Compiler&, ClosureVersion* cls, Code* code,
+bool GVN::apply(Compiler& cmp, ClosureVersion* cls, Code* code,
                 LogStream& log) const {
-    std::unordered_map<size_t, SmallSet<Value*>> reverseNumber;
-    std::unordered_map<Value*, size_t> number;
+    ArenaMap<size_t, SmallSet<Value*>> reverseNumber(cmp.tables());
+    ArenaMap<Value*, size_t> number(cmp.tables());
     {
-        std::unordered_map<size_t, std::vector<size_t>> classes;
-        std::unordered_map<SEXP, size_t> constants;
+        ArenaMap<size_t, std::vector<size_t>> classes(cmp.tables());
+        ArenaMap<SEXP, size_t> constants(cmp.tables());
 
         bool changed = true;
         size_t nextNumber = 0;
@@ -162,6 +162,21 @@ class PASS(Overflow, true, false);
  */
 class PASS(HoistInstruction, false, false);
 
+/*
+ * Fuses trees of elementwise arithmetic on plain vectors, e.g. `a * b + c`,
+ * into one Elementwise instruction. The backend lowers it to a single loop
+ * which only allocates the final result.
+ */
+class PASS(FuseElementwise, false, false);
+
+/*
+ * Removes small vectors from `c()` and `list()` which do not escape (see
+ * EscapeAnalysis). Element reads are replaced by the elements, element
+ * assignments and phis of vectors become one SSA value per element, and the
+ * vector is rematerialized in the deopt branches which need it.
+ */
+class PASS(ScalarReplacement, false, false);
+
 class PhaseMarker : public Pass {
   public:
     explicit PhaseMarker(const std::string& name) : Pass(name) {}
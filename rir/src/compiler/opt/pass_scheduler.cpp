@@ -37,6 +37,7 @@ PassScheduler::PassScheduler() {
         add<LoadElision>();
         add<GVN>();
         add<Constantfold>();
+        add<ScalarReplacement>();
         add<DeadStoreRemoval>();
 
         add<Inline>();
@@ -114,6 +115,7 @@ PassScheduler::PassScheduler() {
 
     nextPhase("Final post");
     addDefaultPostPhaseOpt();
+    add<FuseElementwise>();
     add<Cleanup>();
     add<CleanupCheckpoints>();
 
@@ -0,0 +1,101 @@
+#include "../analysis/escape.h"
+#include "../pir/pir_impl.h"
+#include "R/r.h"
+#include "pass_definitions.h"
+
+#include <functional>
+#include <unordered_map>
+
+namespace rir {
+namespace pir {
+
+bool ScalarReplacement::apply(Compiler&, ClosureVersion* cls, Code* code,
+                              LogStream&) const {
+    EscapeAnalysis escape(code);
+    bool anyChange = false;
+
+    // Removed instructions might be the last ones to set visibility
+    auto removeKeepVisible = [](Instruction* i) {
+        auto bb = i->bb();
+        auto it = bb->atPosition(i);
+        if (i->hasVisibility())
+            bb->replace(it, new Visible());
+        else
+            bb->remove(it);
+    };
+
+    std::unordered_map<Instruction*, const EscapeAnalysis::Allocation*>
+        aggregate;
+    for (auto& a : escape.nonEscaping())
+        aggregate[a.alloc] = &a;
+
+    // The elements of every vector value. For a phi of vectors there is one
+    // phi per element, which is registered before its inputs are computed,
+    // such that cycles through loops end there.
+    std::unordered_map<Instruction*, std::vector<Value*>> elements;
+    std::function<const std::vector<Value*>&(Instruction*)> elementsOf =
+        [&](Instruction* i) -> const std::vector<Value*>& {
+        auto e = elements.find(i);
+        if (e != elements.end())
+            return e->second;
+        auto& a = *aggregate.at(i);
+        auto& res = elements[i];
+        if (i == a.root) {
+            a.root->eachCallArg([&](Value* v) { res.push_back(v); });
+        } else if (auto phi = Phi::Cast(i)) {
+            std::vector<Phi*> phis;
+            for (size_t k = 0; k < a.length; ++k) {
+                auto p = new Phi;
+                p->type = a.element;
+                phi->bb()->insert(phi->bb()->begin(), p);
+                phis.push_back(p);
+                res.push_back(p);
+            }
+            phi->eachArg([&](BB* in, Value* v) {
+                auto& inElements = elementsOf(Instruction::Cast(v));
+                for (size_t k = 0; k < a.length; ++k)
+                    phis[k]->addInput(in, inElements[k]);
+            });
+        } else {
+            res = elementsOf(Instruction::Cast(i->arg(1).val()));
+            res[a.assigned] = i->arg(0).val();
+        }
+        return res;
+    };
+
+    for (auto& a : escape.nonEscaping()) {
+        auto& elts = elementsOf(a.alloc);
+
+        // Rematerialize the object in every deopt branch which needs it. The
+        // elements dominate the vector value, which dominates the uses.
+        for (auto bb : a.deoptUses) {
+            auto copy = a.root->clone();
+            for (size_t k = 0; k < a.length; ++k)
+                copy->arg(k).val() = elts[k];
+            bb->insert(bb->begin(), copy);
+            a.alloc->replaceUsesIn(copy, bb);
+        }
+
+        for (auto& r : a.reads) {
+            r.first->replaceUsesWith(elts[r.second]);
+            removeKeepVisible(r.first);
+        }
+        for (auto l : a.lengths) {
+            auto n = new LdConst(ScalarInteger(a.length));
+            l->bb()->insert(l->bb()->atPosition(l), n);
+            l->replaceUsesWith(n);
+            l->bb()->remove(l);
+        }
+        anyChange = true;
+    }
+
+    // Only now, since the elements of one vector value refer to the ones it is
+    // derived from
+    for (auto& a : escape.nonEscaping())
+        removeKeepVisible(a.alloc);
+
+    return anyChange;
+}
+
+} // namespace pir
+} // namespace rir
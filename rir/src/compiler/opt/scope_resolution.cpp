@@ -1,5 +1,7 @@
 #include "../analysis/query.h"
 #include "../analysis/scope.h"
+#include "../compiler.h"
+#include "../parameter.h"
 #include "../pir/pir_impl.h"
 #include "../util/phi_placement.h"
 #include "../util/safe_builtins_list.h"
@@ -92,8 +94,13 @@ static bool noReflection(ClosureVersion* cls, Code* code, Value* callEnv,
 namespace rir {
 namespace pir {
 
-bool ScopeResolution::apply(Compiler&, ClosureVersion* cls, Code* code,
+bool ScopeResolution::apply(Compiler& cmp, ClosureVersion* cls, Code* code,
                             LogStream& log) const {
+    // The analysis is superlinear in the code size, huge code is left as is
+    size_t size = 0;
+    Visitor::run(code->entry, [&](BB* bb) { size += bb->size(); });
+    if (size > Parameter::SCOPE_RESOLUTION_BUDGET)
+        return false;
 
     DominanceGraph dom(code);
     DominanceFrontier dfront(code, dom);
@@ -105,7 +112,7 @@ bool ScopeResolution::apply(Compiler&, ClosureVersion* cls, Code* code,
     if (finalState.noReflection() && code == cls)
         cls->properties.set(ClosureVersion::Property::NoReflection);
 
-    std::unordered_map<Value*, Value*> replacedValue;
+    ArenaMap<Value*, Value*> replacedValue(cmp.tables());
     struct CreatedPhiCache {
         bool hasUnbound;
         std::unordered_map<BB*, Phi*> phis;
@@ -721,5 +728,10 @@ bool ScopeResolution::apply(Compiler&, ClosureVersion* cls, Code* code,
     return anyChange;
 }
 
+size_t Parameter::SCOPE_RESOLUTION_BUDGET =
+    getenv("PIR_SCOPE_RESOLUTION_BUDGET")
+        ? atoi(getenv("PIR_SCOPE_RESOLUTION_BUDGET"))
+        : 20000;
+
 } // namespace pir
 } // namespace rir
@@ -2,6 +2,7 @@
 #include "../util/visitor.h"
 #include "R/Funtab.h"
 #include "compiler/analysis/cfg.h"
+#include "compiler/compiler.h"
 
 #include "../analysis/abstract_value.h"
 #include "../analysis/range.h"
@@ -14,12 +15,12 @@
 namespace rir {
 namespace pir {
 
-bool TypeInference::apply(Compiler&, ClosureVersion* cls, Code* code,
+bool TypeInference::apply(Compiler& cmp, ClosureVersion* cls, Code* code,
                           LogStream& log) const {
 
     RangeAnalysis rangeAnalysis(cls, code, log);
 
-    std::unordered_map<Instruction*, PirType> types;
+    ArenaMap<Instruction*, PirType> types(cmp.tables());
     {
         bool done = false;
         auto apply = [&]() {
@@ -82,6 +83,11 @@ bool TypeInference::apply(Compiler&, ClosureVersion* cls, Code* code,
 
                                 if (doSummary)
                                     inferred = inferred.simpleScalar();
+                                // Empty int vectors have +-Inf as extremum
+                                if (("min" == name || "max" == name) &&
+                                    inferred.maybe(RType::integer) &&
+                                    !m.isSimpleScalar())
+                                    inferred = inferred.orT(RType::real);
                                 if ("prod" == name)
                                     inferred = inferred.orT(RType::real)
                                                    .notT(RType::integer);
@@ -95,6 +101,36 @@ bool TypeInference::apply(Compiler&, ClosureVersion* cls, Code* code,
                         }
                     }
 
+                    if ("mean" == name && c->nCallArgs() == 1) {
+                        if (getType(c->callArg(0).val())
+                                .isA(PirType::intRealLgl())) {
+                            inferred = PirType(RType::real).simpleScalar();
+                            break;
+                        }
+                    }
+
+                    if (("any" == name || "all" == name) &&
+                        c->nCallArgs() == 1) {
+                        if (getType(c->callArg(0).val())
+                                .isA(PirType(RType::logical))) {
+                            inferred = PirType(RType::logical).simpleScalar();
+                            break;
+                        }
+                    }
+
+                    if ("which" == name && c->nCallArgs() == 1) {
+                        if (getType(c->callArg(0).val())
+                                .isA(PirType(RType::logical)
+                                         .orAttribsOrObj()
+                                         .notObject())) {
+                            inferred = PirType(RType::integer);
+                            if (getType(c->callArg(0).val()).maybeHasAttrs())
+                                inferred =
+                                    inferred.orAttribsOrObj().notObject();
+                            break;
+                        }
+                    }
+
                     if ("sqrt" == name) {
                         if (c->nCallArgs()) {
                             auto m = PirType::bottom();
@@ -13,6 +13,13 @@ struct Parameter {
     static size_t MAX_INPUT_SIZE;
     static unsigned RIR_WARMUP;
     static unsigned DEOPT_ABANDON;
+    static bool PIR_OSR;
+    static unsigned PIR_OSR_THRESHOLD;
+    static bool PIR_REGIONS;
+    static bool DEOPTLESS;
+    static unsigned DEOPTLESS_MAX_CONTINUATIONS;
+    static bool RIR_PACK_DOTS;
+    static bool RIR_S3_CACHE;
 
     static size_t PROMISE_INLINER_MAX_SIZE;
 
@@ -20,6 +27,11 @@ struct Parameter {
     static size_t INLINER_MAX_INLINEE_SIZE;
     static size_t INLINER_INITIAL_FUEL;
     static size_t INLINER_INLINE_UNLIKELY;
+    static bool INLINER_BY_FREQUENCY;
+    static size_t POLYMORPHIC_CALL_ARMS;
+
+    static size_t SCOPE_RESOLUTION_BUDGET;
+    static size_t ALLOCATOR_BUDGET;
 
     static bool RIR_PRESERVE;
     static unsigned RIR_SERIALIZE_CHAOS;
@@ -27,8 +39,19 @@ struct Parameter {
     static unsigned RIR_CHECK_PIR_TYPES;
 
     static unsigned PIR_LLVM_OPT_LEVEL;
+    static bool PIR_LLVM_TIERING;
+    static unsigned PIR_LLVM_TIER1_OPT_LEVEL;
+    static unsigned PIR_LLVM_TIER2_THRESHOLD;
+    static bool PIR_UNBOXED_CALLS;
 
     static bool ENABLE_PIR2RIR;
+
+    static bool PIR_ARENA;
+
+    static bool BACKGROUND_COMPILE;
+
+    static const char* CODE_CACHE;
+    static const char* COMPILE_CORPUS;
 };
 } // namespace pir
 } // namespace rir
@@ -204,10 +204,12 @@ unsigned BB::indexOf(const Instruction* i) {
 }
 
 void BB::gc() {
+#ifndef NDEBUG
     // Catch double deletes
     std::unordered_set<Instruction*> dup;
     dup.insert(deleted.begin(), deleted.end());
     assert(dup.size() == deleted.size());
+#endif
 
     for (auto i : deleted)
         delete i;
@@ -2,6 +2,7 @@
 #define COMPILER_BB_H
 
 #include "common.h"
+#include "compiler/util/arena.h"
 #include "pir.h"
 
 #include "utils/Set.h"
@@ -44,6 +45,12 @@ class BB {
     BB(Code* fun, unsigned id);
     ~BB();
 
+    // Allocated in the arena of the module, see arena.h
+    static void* operator new(size_t size) {
+        return Arena::allocateObject(size);
+    }
+    static void operator delete(void* p) { Arena::deallocateObject(p); }
+
     static BB* cloneInstrs(BB* src, unsigned id, Code* target);
 
     void unsafeSetId(unsigned newId) { *const_cast<unsigned*>(&id) = newId; }
@@ -137,6 +137,20 @@ Builder::Builder(ClosureVersion* version, Value* closureEnv)
     this->env = mkenv;
 }
 
+Builder::Builder(ClosureVersion* continuation)
+    : function(continuation), code(continuation), env(nullptr) {
+    createNextBB();
+    assert(!function->entry);
+    function->entry = bb;
+
+    // Create another BB to ensure that the entry BB has no predecessors.
+    createNextBB();
+
+    auto ldenv = new LdFunctionEnv();
+    add(ldenv);
+    this->env = ldenv;
+}
+
 Builder::Builder(ClosureVersion* fun, Promise* prom)
     : function(fun), code(prom), env(nullptr) {
     createNextBB();
@@ -27,6 +27,9 @@ class Builder {
 
     Builder(ClosureVersion* fun, Promise* prom);
     Builder(ClosureVersion* fun, Value* enclos);
+    // Entry of an OSR continuation, which runs in the environment of the
+    // interpreter frame it replaces
+    explicit Builder(ClosureVersion* continuation);
 
     Value* buildDefaultEnv(ClosureVersion* fun);
 
@@ -1,6 +1,7 @@
 #ifndef COMPILER_CODE_H
 #define COMPILER_CODE_H
 
+#include "compiler/util/arena.h"
 #include "pir.h"
 
 #include <cstddef>
@@ -37,6 +38,12 @@ class Code {
     void printBBGraphCode(std::ostream&, bool omitDeoptBranches) const;
     virtual ~Code();
 
+    // Allocated in the arena of the module, see arena.h
+    static void* operator new(size_t size) {
+        return Arena::allocateObject(size);
+    }
+    static void operator delete(void* p) { Arena::deallocateObject(p); }
+
     size_t numInstrs() const;
 
     virtual rir::Code* rirSrc() const = 0;
@@ -558,6 +558,56 @@ void CastType::printArgs(std::ostream& out, bool tty) const {
     FixedLenInstruction::printArgs(out, tty);
 }
 
+void Elementwise::printArgs(std::ostream& out, bool tty) const {
+    std::function<void(const Node&)> printNode = [&](const Node& n) {
+        if (n.leaf()) {
+            arg(n.lhs).val()->printRef(out);
+            return;
+        }
+        out << "(";
+        printNode(nodes.at(n.lhs));
+        switch (n.op) {
+        case Tag::Add:
+            out << " + ";
+            break;
+        case Tag::Sub:
+            out << " - ";
+            break;
+        case Tag::Mul:
+            out << " * ";
+            break;
+        case Tag::Div:
+            out << " / ";
+            break;
+        case Tag::Lt:
+            out << " < ";
+            break;
+        case Tag::Lte:
+            out << " <= ";
+            break;
+        case Tag::Gt:
+            out << " > ";
+            break;
+        case Tag::Gte:
+            out << " >= ";
+            break;
+        case Tag::Eq:
+            out << " == ";
+            break;
+        case Tag::Neq:
+            out << " != ";
+            break;
+        default:
+            assert(false);
+        }
+        printNode(nodes.at(n.rhs));
+        out << ")";
+    };
+    printNode(root());
+    if (hasEnv())
+        out << ", ";
+}
+
 void Branch::printGraphArgs(std::ostream& out, bool tty) const {
     FixedLenInstruction::printArgs(out, tty);
 }
@@ -2,6 +2,7 @@
 #define COMPILER_INSTRUCTION_H
 
 #include "R/r.h"
+#include "compiler/util/arena.h"
 #include "env.h"
 #include "instruction_list.h"
 #include "ir/BC_inc.h"
@@ -269,6 +270,12 @@ class Instruction : public Value {
 
     virtual ~Instruction() {}
 
+    // Allocated in the arena of the module, see arena.h
+    static void* operator new(size_t size) {
+        return Arena::allocateObject(size);
+    }
+    static void operator delete(void* p) { Arena::deallocateObject(p); }
+
     InstructionUID id() const;
 
     virtual std::string name() const { return tagToStr(tag); }
@@ -1949,6 +1956,38 @@ BINOP_NOENV(LOr, PirType::simpleScalarLogical());
 
 #undef BINOP_NOENV
 
+/*
+ * A fused tree of elementwise arithmetic on plain vectors (see
+ * FuseElementwise). The arguments are the leaves of the tree. The nodes are
+ * stored in post order, the last one is the root.
+ */
+class VLIE(Elementwise, Effects::Any()) {
+  public:
+    struct Node {
+        // The binop of the node (e.g. Tag::Add), Tag::Nop for leaves
+        Tag op;
+        // Leaves: argument index, otherwise the indices of the operand nodes
+        unsigned lhs;
+        unsigned rhs;
+        unsigned srcIdx;
+        bool leaf() const { return op == Tag::Nop; }
+    };
+    std::vector<Node> nodes;
+
+    Elementwise(PirType type, Value* env, Effects e, unsigned srcIdx)
+        : VarLenInstructionWithEnvSlot(type, env, srcIdx) {
+        effects = e;
+    }
+
+    size_t nLeaves() const { return nargs() - 1; }
+    const Node& root() const { return nodes.back(); }
+
+    void printArgs(std::ostream& out, bool tty) const override;
+    VisibilityFlag visibilityFlag() const override {
+        return VisibilityFlag::On;
+    }
+};
+
 template <typename BASE, Tag TAG>
 class Unop
     : public FixedLenInstructionWithEnvSlot<TAG, BASE, 2, Effects::AnyI(),
@@ -84,6 +84,7 @@
     V(IsType)                                                                  \
     V(Plus)                                                                    \
     V(Minus)                                                                   \
+    V(Elementwise)                                                             \
     V(Identical)                                                               \
     V(ForSeqSize)                                                              \
     V(Length)                                                                  \
@@ -1,6 +1,8 @@
 #include "module.h"
 #include "pir_impl.h"
 
+#include <chrono>
+
 namespace rir {
 namespace pir {
 
@@ -36,14 +38,28 @@ Closure* Module::getOrDeclareRirClosure(const std::string& name, SEXP closure,
     return closures.at(id);
 }
 
+Closure* Module::declareContinuation(const std::string& name, SEXP closure,
+                                     rir::Function* f, Context userContext) {
+    auto env = f->flags.contains(Function::InnerFunction)
+                   ? Env::notClosed()
+                   : getEnv(CLOENV(closure));
+    auto c = new Closure(name, closure, f, env, userContext);
+    continuations.push_back(c);
+    return c;
+}
+
 void Module::eachPirClosure(PirClosureIterator it) {
     for (auto& c : closures)
         it(c.second);
+    for (auto c : continuations)
+        it(c);
 }
 
 void Module::eachPirClosureVersion(PirClosureVersionIterator it) {
     for (auto& c : closures)
         c.second->eachVersion(it);
+    for (auto c : continuations)
+        c->eachVersion(it);
 }
 
 Env* Module::getEnv(SEXP rho) {
@@ -63,10 +79,17 @@ Env* Module::getEnv(SEXP rho) {
 }
 
 Module::~Module() {
+    auto start = std::chrono::steady_clock::now();
     for (auto& e : environments)
         delete e.second;
     for (auto& cs : closures)
         delete cs.second;
+    for (auto c : continuations)
+        delete c;
+    arena.release();
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    Arena::stats().teardownTime += time.count();
 }
 }
 }
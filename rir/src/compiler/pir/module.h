@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "compiler/util/arena.h"
 #include "pir.h"
 #include "runtime/Function.h"
 
@@ -15,6 +16,10 @@ namespace rir {
 namespace pir {
 
 class Module {
+    // Declared first, such that it is destroyed last
+    Arena arena;
+    Arena::Scope arenaScope{arena};
+
     std::unordered_map<SEXP, Env*> environments;
 
   public:
@@ -27,6 +32,10 @@ class Module {
                                      Context userContext);
     Closure* getOrDeclareRirClosure(const std::string& name, SEXP closure,
                                     rir::Function* f, Context userContext);
+    // Continuations are kept apart from the closures, such that calls to the
+    // closure never dispatch to them
+    Closure* declareContinuation(const std::string& name, SEXP closure,
+                                 rir::Function* f, Context userContext);
 
     typedef std::function<void(pir::Closure*)> PirClosureIterator;
     typedef std::function<void(pir::ClosureVersion*)> PirClosureVersionIterator;
@@ -37,6 +46,7 @@ class Module {
   private:
     typedef std::pair<Function*, Env*> Idx;
     std::map<Idx, Closure*> closures;
+    std::vector<Closure*> continuations;
 };
 
 }
@@ -7,6 +7,7 @@
 #include "compiler/analysis/query.h"
 #include "compiler/analysis/verifier.h"
 #include "compiler/opt/pass_definitions.h"
+#include "compiler/parameter.h"
 #include "compiler/pir/builder.h"
 #include "compiler/pir/pir_impl.h"
 #include "compiler/util/arg_match.h"
@@ -189,6 +190,8 @@ struct TargetInfo {
     SEXP monomorphic;
     size_t taken;
     bool stableEnv;
+    // All observed closures, if there is no monomorphic target
+    std::vector<SEXP> polymorphic;
 };
 static TargetInfo
 checkCallTarget(Value* callee, rir::Code* srcCode,
@@ -228,6 +231,13 @@ checkCallTarget(Value* callee, rir::Code* srcCode,
                     result.monomorphic = first;
                 if (stableEnv)
                     result.stableEnv = true;
+                if (!stableBody) {
+                    for (size_t i = 0; i < feedback.numTargets; ++i) {
+                        SEXP b = feedback.getTarget(srcCode, i);
+                        if (isValidClosureSEXP(b))
+                            result.polymorphic.push_back(b);
+                    }
+                }
             }
         }
     }
@@ -654,6 +664,10 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
             if (arity != -1 && arity != nargs)
                 monomorphicBuiltin = false;
         }
+        bool polymorphicClosures =
+            !ti.monomorphic && ti.polymorphic.size() > 1 &&
+            Parameter::POLYMORPHIC_CALL_ARMS > 0 && !inPromise() &&
+            !inlining() && bc.bc == Opcode::call_;
         const std::unordered_set<int> supportedSpecials = {blt("forceAndCall")};
         bool monomorphicSpecial =
             ti.monomorphic && TYPEOF(ti.monomorphic) == SPECIALSXP &&
@@ -866,6 +880,115 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
                 compiler.compileClosure(ti.monomorphic, name, given, false,
                                         apply, emitGenericCall, outerFeedback);
             }
+        } else if (polymorphicClosures) {
+            // Type-switch over the observed closures, with a generic call as
+            // the fallback:
+            //
+            //   if (callee == t1) StaticCall(t1) else if ... else Call(callee)
+            //
+            // Every arm is a static call, which the inliner can pick up later.
+            // Only simple calls are handled: positional arguments and no dots
+            // in the formals of the target.
+            struct Arm {
+                SEXP target;
+                ClosureVersion* version;
+                Context given;
+            };
+            std::vector<Arm> arms;
+
+            Context given;
+            given.add(Assumption::NoExplicitlyMissingArgs);
+            given.add(Assumption::NotTooManyArguments);
+            given.add(Assumption::CorrectOrderOfArguments);
+            given.add(Assumption::StaticallyArgmatched);
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (args[i] == MissingArg::instance()) {
+                    given.remove(Assumption::NoExplicitlyMissingArgs);
+                } else {
+                    if (auto j = Instruction::Cast(args[i]))
+                        j->updateTypeAndEffects();
+                    args[i]->callArgTypeToContext(given, i);
+                }
+            }
+
+            std::string name = "";
+            if (ldfun)
+                name = CHAR(PRINTNAME(ldfun->varName));
+            for (auto target : ti.polymorphic) {
+                if (arms.size() == Parameter::POLYMORPHIC_CALL_ARMS)
+                    break;
+                auto formals = RList(FORMALS(target));
+                size_t needed = 0;
+                bool hasDotsFormals = false;
+                for (auto a = formals.begin(); a != formals.end(); ++a) {
+                    needed++;
+                    if (a.hasTag() && a.tag() == R_DotsSymbol)
+                        hasDotsFormals = true;
+                }
+                if (hasDotsFormals || needed < args.size())
+                    continue;
+                Context armGiven = given;
+                armGiven.numMissing(needed - args.size());
+                compiler.compileClosure(
+                    target, name, armGiven, false,
+                    [&](ClosureVersion* f) {
+                        arms.push_back({target, f, armGiven});
+                    },
+                    []() {}, outerFeedback);
+            }
+
+            if (arms.empty()) {
+                emitGenericCall();
+                break;
+            }
+
+            popn(toPop);
+            auto merge = insert.createBB();
+            auto phi = new Phi;
+            auto setTaken = [&](Instruction* i) {
+                if (ti.taken != (size_t)-1 && srcCode->funInvocationCount)
+                    CallInstruction::CastCall(i)->taken =
+                        (double)ti.taken /
+                        (double)(srcCode->funInvocationCount - 1);
+            };
+            for (auto& arm : arms) {
+                auto expected = insert(new LdConst(arm.target));
+                auto test =
+                    insert(new Identical(callee, expected, PirType::any()));
+                insert(new Branch(test));
+                auto match = insert.createBB();
+                auto mismatch = insert.createBB();
+                insert.setBranch(match, mismatch);
+
+                insert.enterBB(match);
+                auto fs = insert.registerFrameState(srcCode, nextPos, stack,
+                                                    inPromise());
+                auto cl = insert(new StaticCall(
+                    insert.env, arm.version->owner(), arm.given, args,
+                    ArglistOrder::CallArglistOrder(), fs, ast,
+                    Tombstone::closure()));
+                setTaken(cl);
+                phi->addInput(insert.getCurrentBB(), cl);
+                insert.setNext(merge);
+
+                insert.enterBB(mismatch);
+            }
+            auto fs = insert.registerFrameState(srcCode, nextPos, stack,
+                                                inPromise());
+            auto generic = insert(new Call(env, callee, args, fs, ast));
+            setTaken(generic);
+            phi->addInput(insert.getCurrentBB(), generic);
+            insert.setNext(merge);
+
+            insert.enterBB(merge);
+            insert(phi);
+            phi->updateTypeAndEffects();
+            push(phi);
+            // The calls are deopt barriers, which the main loop only sees
+            // if they are the last instruction
+            if (nextPos != srcCode->endCode())
+                addCheckpoint(srcCode, nextPos, stack, insert);
+            break;
         } else {
             emitGenericCall();
         }
@@ -1225,6 +1348,25 @@ bool Rir2Pir::tryCompile(rir::Code* srcCode, Builder& insert) {
     return false;
 }
 
+bool Rir2Pir::tryCompileContinuation(Builder& insert, Opcode* start,
+                                     const std::vector<PirType>& initialStack,
+                                     Opcode* regionBegin, Opcode* regionEnd) {
+    this->regionBegin = regionBegin;
+    this->regionEnd = regionEnd;
+    std::vector<Value*> stack;
+    for (size_t i = 0; i < initialStack.size(); ++i) {
+        auto ld = new LdArg(i);
+        ld->type = initialStack[i];
+        stack.push_back(insert(ld));
+    }
+    auto srcCode = cls->owner()->rirFunction()->body();
+    if (auto res = tryTranslate(srcCode, insert, start, stack)) {
+        finalize(res, insert);
+        return true;
+    }
+    return false;
+}
+
 bool Rir2Pir::tryCompilePromise(rir::Code* prom, Builder& insert) {
     return PromiseRir2Pir(compiler, cls, log, name, outerFeedback, false)
         .tryCompile(prom, insert);
@@ -1236,6 +1378,12 @@ Value* Rir2Pir::tryInlinePromise(rir::Code* srcCode, Builder& insert) {
 }
 
 Value* Rir2Pir::tryTranslate(rir::Code* srcCode, Builder& insert) {
+    return tryTranslate(srcCode, insert, srcCode->code(), {});
+}
+
+Value* Rir2Pir::tryTranslate(rir::Code* srcCode, Builder& insert,
+                             Opcode* start,
+                             const std::vector<Value*>& initialStack) {
     assert(!finalized);
 
     CallTargetFeedback callTargetFeedback;
@@ -1248,9 +1396,11 @@ Value* Rir2Pir::tryTranslate(rir::Code* srcCode, Builder& insert) {
     std::deque<State> worklist;
     State cur;
     cur.seen = true;
+    for (auto v : initialStack)
+        cur.stack.push(v);
 
     Opcode* end = srcCode->endCode();
-    Opcode* finger = srcCode->code();
+    Opcode* finger = start;
 
     auto popWorklist = [&]() {
         assert(!worklist.empty());
@@ -1269,6 +1419,16 @@ Value* Rir2Pir::tryTranslate(rir::Code* srcCode, Builder& insert) {
             finger = popWorklist();
         assert(finger != end);
 
+        // Leaving the region, the rest of the function runs in the baseline
+        if (regionEnd && (finger < regionBegin || finger >= regionEnd)) {
+            auto sp = insert.registerFrameState(srcCode, finger, cur.stack,
+                                                inPromise());
+            insert(new Deopt(sp));
+            cur.stack.clear();
+            finger = end;
+            continue;
+        }
+
         if (mergepoints.count(finger)) {
             State& other = mergepoints.at(finger);
             if (other.seen) {
@@ -1694,5 +1854,10 @@ void Rir2Pir::finalize(Value* ret, Builder& insert) {
     finalized = true;
 }
 
+size_t Parameter::POLYMORPHIC_CALL_ARMS =
+    getenv("PIR_POLYMORPHIC_CALL_ARMS")
+        ? atoi(getenv("PIR_POLYMORPHIC_CALL_ARMS"))
+        : ObservedCallees::MaxTargets;
+
 } // namespace pir
 } // namespace rir
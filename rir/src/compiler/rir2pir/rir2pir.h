@@ -21,6 +21,16 @@ class Rir2Pir {
 
     bool tryCompile(Builder& insert) __attribute__((warn_unused_result));
 
+    // Compiles the rest of the function body, starting at start. The values
+    // on the interpreter stack at that point are passed as arguments, with the
+    // given types. If a region [regionBegin, regionEnd) is given, only the
+    // bytecode inside is compiled, leaving the region deopts to the baseline.
+    bool tryCompileContinuation(Builder& insert, Opcode* start,
+                                const std::vector<PirType>& initialStack,
+                                Opcode* regionBegin = nullptr,
+                                Opcode* regionEnd = nullptr)
+        __attribute__((warn_unused_result));
+
     Value* tryCreateArg(rir::Code* prom, Builder& insert, bool eager)
         __attribute__((warn_unused_result));
 
@@ -41,6 +51,9 @@ class Rir2Pir {
 
     Value* tryTranslate(rir::Code* srcCode, Builder& insert)
         __attribute__((warn_unused_result));
+    Value* tryTranslate(rir::Code* srcCode, Builder& insert, Opcode* start,
+                        const std::vector<Value*>& initialStack)
+        __attribute__((warn_unused_result));
 
     void finalize(Value*, Builder& insert);
 
@@ -52,6 +65,9 @@ class Rir2Pir {
     std::string name;
     std::list<PirTypeFeedback*> outerFeedback;
 
+    Opcode* regionBegin = nullptr;
+    Opcode* regionEnd = nullptr;
+
     struct DelayedCompilation {
         DispatchTable* dt;
         std::string name;
@@ -0,0 +1,103 @@
+#include "arena.h"
+#include "compiler/parameter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace rir {
+namespace pir {
+
+namespace {
+
+// Keeps the objects behind the header aligned
+constexpr size_t HEADER = alignof(std::max_align_t);
+
+thread_local Arena* installed_ = nullptr;
+thread_local Arena::Stats stats_;
+
+} // namespace
+
+constexpr size_t Arena::CHUNK_SIZE;
+
+void* Arena::allocate(size_t size) {
+    size = (size + HEADER - 1) & ~(HEADER - 1);
+    if (size > (size_t)(end - pos)) {
+        auto chunkSize = std::max(size, CHUNK_SIZE);
+        auto chunk = static_cast<char*>(::operator new(chunkSize));
+        stats_.mallocs++;
+        chunks.push_back(chunk);
+        // Large allocations get a chunk of their own
+        if (chunkSize > CHUNK_SIZE)
+            return chunk;
+        pos = chunk;
+        end = chunk + chunkSize;
+    }
+    auto res = pos;
+    pos += size;
+    return res;
+}
+
+void Arena::release() {
+    for (auto c : chunks)
+        ::operator delete(c);
+    chunks.clear();
+    pos = end = nullptr;
+}
+
+void Arena::rewind() {
+    if (!end)
+        return release();
+    auto keep = end - CHUNK_SIZE;
+    for (auto c : chunks)
+        if (c != keep)
+            ::operator delete(c);
+    chunks.clear();
+    chunks.push_back(keep);
+    pos = keep;
+}
+
+Arena::Scope::Scope(Arena& arena)
+    : installed(!installed_ && Parameter::PIR_ARENA) {
+    if (installed)
+        installed_ = &arena;
+}
+
+Arena::Scope::~Scope() {
+    if (installed)
+        installed_ = nullptr;
+}
+
+void* Arena::allocateObject(size_t size) {
+    stats_.objects++;
+    auto arena = installed_;
+    char* p;
+    if (arena) {
+        p = static_cast<char*>(arena->allocate(HEADER + size));
+    } else {
+        p = static_cast<char*>(::operator new(HEADER + size));
+        stats_.mallocs++;
+    }
+    memcpy(p, &arena, sizeof(arena));
+    return p + HEADER;
+}
+
+void Arena::deallocateObject(void* obj) {
+    if (!obj)
+        return;
+    auto p = static_cast<char*>(obj) - HEADER;
+    Arena* arena;
+    memcpy(&arena, p, sizeof(arena));
+    // Arena memory is released with the arena
+    if (!arena)
+        ::operator delete(p);
+}
+
+Arena::Stats& Arena::stats() { return stats_; }
+
+bool Parameter::PIR_ARENA =
+    !getenv("PIR_ARENA") || 0 != strncmp("0", getenv("PIR_ARENA"), 1);
+
+} // namespace pir
+} // namespace rir
@@ -0,0 +1,111 @@
+#ifndef COMPILER_ARENA_H
+#define COMPILER_ARENA_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace rir {
+namespace pir {
+
+/*
+ * Bump allocator for the compiler.
+ *
+ * The module being compiled owns an arena. IR objects (instructions, BBs,
+ * promises and closure versions) are allocated in it by their operator new.
+ * Deleting one runs its destructor, but the memory is only released when the
+ * module is destroyed, all chunks at once.
+ *
+ * Objects created while no arena is installed, e.g. on the worker thread or
+ * with PIR_ARENA=0, come from malloc. A header in front of every object
+ * records where it came from.
+ *
+ * Passes put their side tables into the arena of the compiler through
+ * ArenaAllocator, the backend into its own. These are rewound after every
+ * pass, respectively compiled closure version, keeping their first chunk.
+ */
+class Arena {
+  public:
+    Arena() {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() { release(); }
+
+    void* allocate(size_t size);
+    void release();
+    // Frees everything but the current chunk, which is reused
+    void rewind();
+
+    // Installs an arena for IR objects on this thread while in scope. If
+    // another one is installed already, that one is kept. Objects of nested
+    // modules then live in the outermost arena, which outlives them.
+    class Scope {
+      public:
+        explicit Scope(Arena& arena);
+        ~Scope();
+
+      private:
+        bool installed;
+    };
+
+    // operator new and delete of IR objects
+    static void* allocateObject(size_t size);
+    static void deallocateObject(void* p);
+
+    // Counters of this thread
+    struct Stats {
+        size_t objects = 0;
+        // Calls to malloc for IR objects and arena chunks
+        size_t mallocs = 0;
+        double teardownTime = 0;
+    };
+    static Stats& stats();
+
+  private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    std::vector<char*> chunks;
+    char* pos = nullptr;
+    char* end = nullptr;
+};
+
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+
+    Arena* arena;
+
+    // cppcheck-suppress noExplicitConstructor
+    ArenaAllocator(Arena& arena) : arena(&arena) {}
+    template <typename U>
+    // cppcheck-suppress noExplicitConstructor
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return arena != other.arena;
+    }
+};
+
+template <typename T>
+using ArenaSet = std::unordered_set<T, std::hash<T>, std::equal_to<T>,
+                                    ArenaAllocator<T>>;
+template <typename K, typename V>
+using ArenaMap =
+    std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
+                       ArenaAllocator<std::pair<const K, V>>>;
+
+} // namespace pir
+} // namespace rir
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "compiler/analysis/cfg.h"
 #include "compiler/analysis/liveness.h"
+#include "compiler/parameter.h"
 #include "compiler/pir/pir.h"
 #include "interpreter/cache.h"
 
@@ -27,6 +28,10 @@ namespace pir {
  *    2. Traverse the dominance tree and eagerly allocate the remaining ones
  * 5. For debugging, verify the assignment with a static analysis that simulates
  *    the variable and stack usage (see verify).
+ *
+ * Testing a slot checks interference with every value already assigned to it,
+ * which is quadratic for large functions. After Parameter::ALLOCATOR_BUDGET
+ * interference checks the remaining values get fresh slots instead.
  */
 
 class SSAAllocator {
@@ -72,15 +77,34 @@ class SSAAllocator {
     virtual void computeAllocation() {
         std::unordered_map<SlotNumber, std::unordered_set<Instruction*>>
             reverseAlloc;
+        size_t budget = Parameter::ALLOCATOR_BUDGET;
+        SlotNumber lastSlot = unassignedSlot;
+        auto assign = [&](SlotNumber slot, Value* v) {
+            allocation[v] = slot;
+            if (auto i = Instruction::Cast(v))
+                reverseAlloc[slot].insert(i);
+            if (slot > lastSlot)
+                lastSlot = slot;
+        };
         auto slotIsAvailable = [&](SlotNumber slot, Value* v) {
             if (auto i = Instruction::Cast(v)) {
-                for (auto other : reverseAlloc[slot]) {
+                auto& others = reverseAlloc[slot];
+                if (others.size() > budget) {
+                    budget = 0;
+                    return others.empty();
+                }
+                budget -= others.size();
+                for (auto other : others) {
                     if (interfere(other, i))
                         return false;
                 }
             }
             return true;
         };
+        // The first slot to try when searching for a free one
+        auto firstSlot = [&]() {
+            return budget ? unassignedSlot + 1 : lastSlot + 1;
+        };
 
         // Precolor Phi
         Visitor::run(code->entry, [&](Instruction* i) {
@@ -99,25 +123,21 @@ class SSAAllocator {
                 }
                 return success;
             };
-            SlotNumber slot = unassignedSlot;
+            SlotNumber slot;
             auto h = hints.find(i);
             if (h != hints.end() && testSlot(h->second)) {
                 slot = h->second;
             } else {
-                while (true) {
-                    ++slot;
+                for (slot = firstSlot();; ++slot) {
                     if ((h == hints.end() || h->second != slot) &&
                         testSlot(slot))
                         break;
                 }
             }
-            allocation[i] = slot;
-            reverseAlloc[slot].insert(i);
+            assign(slot, i);
             p->eachArg([&](BB*, Value* v) {
-                allocation[v] = slot;
+                assign(slot, v);
                 auto j = Instruction::Cast(v);
-                if (j)
-                    reverseAlloc[slot].insert(j);
                 while (j) {
                     if (j->nargs() == 0)
                         break;
@@ -137,12 +157,9 @@ class SSAAllocator {
         // such that every phi input is only used exactly once (by the phi).
         DominatorTreeVisitor<>(dom).run(code->entry, [&](BB* bb) {
             auto findFreeSlot = [&](Instruction* i) {
-                SlotNumber slot = unassignedSlot;
-                for (;;) {
-                    ++slot;
+                for (auto slot = firstSlot();; ++slot) {
                     if (slotIsAvailable(slot, i)) {
-                        allocation[i] = slot;
-                        reverseAlloc[slot].insert(i);
+                        assign(slot, i);
                         break;
                     }
                 };
@@ -167,8 +184,7 @@ class SSAAllocator {
                             hint = allocation.at(o);
                     }
                     if (hint != unassignedSlot && slotIsAvailable(hint, i)) {
-                        allocation[i] = hint;
-                        reverseAlloc[hint].insert(i);
+                        assign(hint, i);
                     } else {
                         findFreeSlot(i);
                     }
@@ -2,6 +2,7 @@
 #define RIR_INTERPRETER_CACHE_H
 
 #include "R/r.h"
+#include "global_cells.h"
 #include "instance.h"
 #include <type_traits>
 
@@ -14,6 +15,10 @@ namespace rir {
 #define BINDING_IS_LOCKED(b) ((b)->sxpinfo.gp & BINDING_LOCK_MASK)
 #define FRAME_LOCK_MASK (1 << 14)
 #define FRAME_IS_LOCKED(e) (ENVFLAGS(e) & FRAME_LOCK_MASK)
+#ifndef BASE_SYM_CACHED
+#define BASE_SYM_CACHED_MASK (1 << 13)
+#define BASE_SYM_CACHED(b) ((b)->sxpinfo.gp & BASE_SYM_CACHED_MASK)
+#endif
 
 #ifdef CACHE_ON_R_STACK
 // TODO: Create a version with a cache on the R_stack instead of the C stack
@@ -86,6 +91,20 @@ inline SEXPTYPE sexptypeOf(SEXP) {
     assert(false && "unreachable");
 }
 
+// Overwrites the bound value cur with the scalar value, if it is an unshared
+// simple scalar of the same type. Returns false if value has to be boxed.
+template <typename T>
+static inline bool updateBoundScalar(SEXP cur, T value) {
+    if (MAYBE_SHARED(cur) || ALTREP(cur) ||
+        !IS_SIMPLE_SCALAR(cur, sexptypeOf(value)))
+        return false;
+    // subassign.c primitives and instructions clear the name expecting a
+    // store to happen later Thus, the increment must be done always
+    ENSURE_NAMED(cur);
+    updateScalar(cur, value);
+    return true;
+}
+
 template <typename T>
 static inline void rirDefineVarWrapper(SEXP symbol, T value, SEXP rho) {
     if (rho == R_EmptyEnv)
@@ -103,14 +122,8 @@ static inline void rirDefineVarWrapper(SEXP symbol, T value, SEXP rho) {
     constexpr auto unboxed = !std::is_same<T, SEXP>::value;
     if (rho == R_BaseNamespace || rho == R_BaseEnv) {
         auto cur = SYMVALUE(symbol);
-        if (unboxed) {
-            if (IS_SIMPLE_SCALAR(cur, sexptypeOf(value)) &&
-                !MAYBE_SHARED(cur)) {
-                ENSURE_NAMED(cur);
-                updateScalar(cur, value);
-                return;
-            }
-        }
+        if (unboxed && updateBoundScalar(cur, value))
+            return;
         auto val = staticBox(value);
         if (!unboxed && SYMVALUE(symbol) == val) {
             ENSURE_NAMED(val);
@@ -131,17 +144,8 @@ static inline void rirDefineVarWrapper(SEXP symbol, T value, SEXP rho) {
     while (frame != R_NilValue) {
         if (TAG(frame) == symbol) {
             SEXP cur = CAR(frame);
-            if (unboxed) {
-                if (!MAYBE_SHARED(cur) &&
-                    IS_SIMPLE_SCALAR(cur, sexptypeOf(value))) {
-                    // subassign.c primitives and instructions clear the name
-                    // expecting a store to happen later Thus, the increment
-                    // must be done always
-                    ENSURE_NAMED(cur);
-                    updateScalar(cur, value);
-                    return;
-                }
-            }
+            if (unboxed && updateBoundScalar(cur, value))
+                return;
             auto val = staticBox(value);
             if (!unboxed && cur == val) {
                 ENSURE_NAMED(cur);
@@ -205,7 +209,7 @@ static RIR_INLINE SEXP cachedGetVar(SEXP env, Immediate poolIdx,
     }
     SEXP sym = cp_pool_at(ctx, poolIdx);
     SLOWASSERT(TYPEOF(sym) == SYMSXP);
-    return Rf_findVar(sym, env);
+    return GlobalCells::findVar(sym, env);
 }
 
 static RIR_INLINE void cachedSetVar(SEXP val, SEXP env, Immediate poolIdx,
@@ -65,6 +65,10 @@ struct CallContext {
     const SEXP callee;
     Context givenContext;
     SEXP arglist = nullptr;
+    // The arguments as supplied, if they differ from the ones passed
+    SEXP promargs = nullptr;
+    // Inline cache of the calling instruction, if any
+    CallSiteCache* siteCache = nullptr;
 
     bool hasEagerCallee() const { return TYPEOF(callee) == BUILTINSXP; }
     bool hasNames() const { return names; }
@@ -0,0 +1,138 @@
+#include "global_cells.h"
+#include "cache.h"
+
+namespace rir {
+
+namespace {
+
+struct Cell {
+    SEXP sym;
+    SEXP top;
+    // The binding cell, or R_BaseEnv for the base binding SYMVALUE(sym)
+    SEXP binding;
+};
+
+constexpr size_t CELLS = 1024;
+Cell cells[CELLS];
+
+// Keeps top and binding of all cells alive, such that their addresses cannot
+// be reused while they are cached
+SEXP alive() {
+    static SEXP store = nullptr;
+    if (!store) {
+        store = Rf_allocVector(VECSXP, 2 * CELLS);
+        R_PreserveObject(store);
+    }
+    return store;
+}
+
+size_t slot(SEXP sym, SEXP top) {
+    auto h = (uintptr_t)sym ^ ((uintptr_t)top >> 5);
+    return (h >> 4) % CELLS;
+}
+
+SEXP read(const Cell& c) {
+    if (c.binding == R_BaseEnv) {
+        if (c.top == R_GlobalEnv && !BASE_SYM_CACHED(c.sym))
+            return nullptr;
+        return SYMVALUE(c.sym);
+    }
+    auto res = CAR(c.binding);
+    return res == R_UnboundValue ? nullptr : res;
+}
+
+SEXP resolve(SEXP sym, SEXP top) {
+    SEXP binding = nullptr;
+    auto loc = R_findVarLocInFrame(top, sym);
+    if (top == R_GlobalEnv) {
+        if (!R_VARLOC_IS_NULL(loc)) {
+            binding = loc.cell;
+        } else {
+            // Fills the global cache of GNU R, which sets BASE_SYM_CACHED
+            Rf_findVar(sym, top);
+            if (BASE_SYM_CACHED(sym))
+                binding = R_BaseEnv;
+        }
+    } else {
+        if (R_VARLOC_IS_NULL(loc))
+            loc = R_findVarLocInFrame(ENCLOS(top), sym);
+        if (!R_VARLOC_IS_NULL(loc))
+            binding = loc.cell;
+        else if (SYMVALUE(sym) != R_UnboundValue)
+            binding = R_BaseEnv;
+    }
+    if (!binding || IS_ACTIVE_BINDING(binding == R_BaseEnv ? sym : binding))
+        return nullptr;
+
+    auto i = slot(sym, top);
+    SET_VECTOR_ELT(alive(), 2 * i, top);
+    SET_VECTOR_ELT(alive(), 2 * i + 1, binding);
+    cells[i] = {sym, top, binding};
+    return read(cells[i]);
+}
+
+bool isFunction(SEXP v) {
+    auto t = TYPEOF(v);
+    return t == CLOSXP || t == BUILTINSXP || t == SPECIALSXP;
+}
+
+} // namespace
+
+bool GlobalCells::isTopEnv(SEXP env) {
+    if (env == R_GlobalEnv)
+        return true;
+    if (env == R_EmptyEnv || env == R_BaseEnv || env == R_BaseNamespace ||
+        OBJECT(env) || HASHTAB(env) == R_NilValue || !FRAME_IS_LOCKED(env))
+        return false;
+    auto imports = ENCLOS(env);
+    return imports != R_EmptyEnv && FRAME_IS_LOCKED(imports) &&
+           ENCLOS(imports) == R_BaseNamespace;
+}
+
+SEXP GlobalCells::get(SEXP sym, SEXP top) {
+    SLOWASSERT(isTopEnv(top));
+    auto& c = cells[slot(sym, top)];
+    if (c.sym == sym && c.top == top)
+        if (auto res = read(c))
+            return res;
+    return resolve(sym, top);
+}
+
+SEXP GlobalCells::findVar(SEXP sym, SEXP env) {
+    auto rho = env;
+    while (rho != R_EmptyEnv && !isTopEnv(rho)) {
+        auto res = Rf_findVarInFrame3(rho, sym, TRUE);
+        if (res != R_UnboundValue)
+            return res;
+        rho = ENCLOS(rho);
+    }
+    if (rho == R_EmptyEnv)
+        return R_UnboundValue;
+    if (auto res = get(sym, rho))
+        return res;
+    return Rf_findVar(sym, rho);
+}
+
+SEXP GlobalCells::findFun(SEXP sym, SEXP env) {
+    auto rho = env;
+    while (rho != R_EmptyEnv && !isTopEnv(rho)) {
+        auto res = Rf_findVarInFrame3(rho, sym, TRUE);
+        if (res != R_UnboundValue) {
+            if (isFunction(res))
+                return res;
+            return Rf_findFun(sym, rho);
+        }
+        rho = ENCLOS(rho);
+    }
+    if (rho == R_EmptyEnv)
+        return Rf_findFun(sym, env);
+    if (auto res = get(sym, rho)) {
+        if (TYPEOF(res) == PROMSXP)
+            res = PRVALUE(res);
+        if (isFunction(res))
+            return res;
+    }
+    return Rf_findFun(sym, rho);
+}
+
+} // namespace rir
@@ -0,0 +1,40 @@
+#ifndef RIR_GLOBAL_CELLS_H
+#define RIR_GLOBAL_CELLS_H
+
+#include "R/r.h"
+
+namespace rir {
+
+/*
+ * Once a lookup of a free variable leaves the local frames it reaches a top
+ * env: the global env or a package namespace. Global cells remember which
+ * binding the rest of the lookup resolves to, such that it can be repeated
+ * without walking the search path.
+ *
+ * A cell is valid as long as the binding was not removed and no shadowing
+ * binding was defined. Instead of an own version counter, which would miss
+ * everything GNU R defines, we rely on the invalidation GNU R already does for
+ * its global cache and the bytecode binding cache:
+ *  - Removing a binding sets its value to R_UnboundValue.
+ *  - BASE_SYM_CACHED(sym) is set while the lookup of sym from the global env
+ *    resolves to base. It is cleared by every define or remove of sym in the
+ *    global env or in an attached env, and by attach and detach.
+ *  - Namespaces and their imports are locked after loading, thus they cannot
+ *    gain bindings and lookups end in the base namespace.
+ */
+struct GlobalCells {
+    // Same as Rf_findVar and Rf_findFun
+    static SEXP findVar(SEXP sym, SEXP env);
+    static SEXP findFun(SEXP sym, SEXP env);
+
+    // The global env, or an env that looks like a namespace
+    static bool isTopEnv(SEXP env);
+
+    // The value of sym, looked up starting at the top env top. Returns
+    // nullptr if the lookup cannot be cached.
+    static SEXP get(SEXP sym, SEXP top);
+};
+
+} // namespace rir
+
+#endif
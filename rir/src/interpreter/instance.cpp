@@ -11,6 +11,9 @@ void initializeResizeableList(ResizeableList* l, size_t capacity, SEXP parent,
     rl_setLength(l, 0);
 }
 
+ScalarStats scalarStats;
+OsrStats osrStats;
+
 SEXP R_Subset2Sym;
 SEXP R_SubsetSym;
 SEXP R_SubassignSym;
@@ -47,6 +50,9 @@ InterpreterInstance* context_create() {
         return rirCompile(closure, R_NilValue);
     };
     c->closureOptimizer = [](SEXP f, const Context&, SEXP n) { return f; };
+    c->closureTierUpOptimizer = c->closureOptimizer;
+    c->continuationCompiler = [](SEXP, Opcode*, R_bcstack_t*, size_t,
+                                 SEXP) -> Function* { return nullptr; };
 
     if (pir && std::string(pir).compare("off") == 0) {
         // do nothing; use defaults
@@ -62,6 +68,8 @@ InterpreterInstance* context_create() {
         };
     } else {
         c->closureOptimizer = rirOptDefaultOpts;
+        c->closureTierUpOptimizer = rirOptTier2;
+        c->continuationCompiler = rirCompileContinuation;
     }
 
     return c;
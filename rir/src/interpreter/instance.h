@@ -27,6 +27,14 @@ typedef std::function<SEXP(SEXP closure, SEXP name)> ClosureCompiler;
 typedef std::function<SEXP(SEXP closure, const rir::Context& assumptions,
                            SEXP name)>
     ClosureOptimizer;
+/** OSR and deoptless API. Given a closure running in the baseline version,
+  compiles the rest of its body starting at pc (a loop header, or the target of
+  a deopt). The stackSize values on the interpreter stack are passed to the
+  result as arguments.
+ */
+typedef std::function<Function*(SEXP closure, Opcode* pc, R_bcstack_t* stack,
+                                size_t stackSize, SEXP name)>
+    ContinuationCompiler;
 
 #define POOL_CAPACITY 4096
 #define STACK_CAPACITY 4096
@@ -62,6 +70,9 @@ struct InterpreterInstance {
     ExprCompiler exprCompiler;
     ClosureCompiler closureCompiler;
     ClosureOptimizer closureOptimizer;
+    // Recompiles a hot tier-1 version, see PIR_LLVM_TIERING
+    ClosureOptimizer closureTierUpOptimizer;
+    ContinuationCompiler continuationCompiler;
 };
 
 // TODO we might actually need to do more for the lengths (i.e. true length vs
@@ -130,6 +141,50 @@ RIR_INLINE void rl_append(ResizeableList* l, SEXP val, SEXP parent,
         ++R_BCNodeStackTop;                                                    \
     } while (0)
 
+// Unboxed scalars. The tag is the SEXPTYPE of the value, the GC skips slots
+// with a non-zero tag. They only ever live on top of the stack for one
+// instruction, see consumesUnboxed in evalRirCode.
+#define ostack_push_int(c, v)                                                  \
+    do {                                                                       \
+        R_BCNodeStackTop->u.ival = (v);                                        \
+        R_BCNodeStackTop->tag = INTSXP;                                        \
+        ++R_BCNodeStackTop;                                                    \
+    } while (0)
+
+#define ostack_push_real(c, v)                                                 \
+    do {                                                                       \
+        R_BCNodeStackTop->u.dval = (v);                                        \
+        R_BCNodeStackTop->tag = REALSXP;                                       \
+        ++R_BCNodeStackTop;                                                    \
+    } while (0)
+
+#define ostack_top_tag(c) ((R_BCNodeStackTop - 1)->tag)
+
+// Scalar results of arithmetic in the interpreter, see rir.scalarStats()
+struct ScalarStats {
+    // Allocated a new box
+    size_t boxed = 0;
+    // Overwrote an unreferenced operand
+    size_t reused = 0;
+    // Stayed unboxed on the stack
+    size_t unboxed = 0;
+    // Of those, stored by updating the bound value in place
+    size_t updatedInPlace = 0;
+};
+extern ScalarStats scalarStats;
+
+// On-stack replacement at hot loops, see rir.osrStats()
+struct OsrStats {
+    // Continuations compiled, and those which failed
+    size_t compiles = 0;
+    size_t failures = 0;
+    // Loops continued in a compiled continuation
+    size_t entries = 0;
+    // Loop headers given up on after PIR_DEOPT_ABANDON invalidations
+    size_t abandoned = 0;
+};
+extern OsrStats osrStats;
+
 RIR_INLINE void ostack_ensureSize(InterpreterInstance* c, unsigned minFree) {
     if ((R_BCNodeStackTop + minFree) >= R_BCNodeStackEnd) {
         // TODO....
@@ -4,11 +4,14 @@
 #include "R/Symbols.h"
 #include "cache.h"
 #include "compiler/compiler.h"
+#include "compiler/native/background_compilation.h"
+#include "compiler/native/code_cache.h"
 #include "compiler/parameter.h"
 #include "ir/Deoptimization.h"
 #include "runtime/LazyArglist.h"
 #include "runtime/LazyEnvironment.h"
 #include "runtime/TypeFeedback_inl.h"
+#include "s3_cache.h"
 #include "safe_force.h"
 #include "utils/Pool.h"
 #include "utils/measuring.h"
@@ -51,7 +54,13 @@ static void printInterp(Opcode* pc, Code* c, InterpreterInstance* ctx) {
             std::cout << " ...";
             break;
         }
-        std::cout << " " << dumpSexp(sexp);
+        auto cell = ostack_cell_at(ctx, i);
+        if (cell->tag == INTSXP)
+            std::cout << " " << cell->u.ival << "L (unboxed)";
+        else if (cell->tag == REALSXP)
+            std::cout << " " << cell->u.dval << " (unboxed)";
+        else
+            std::cout << " " << dumpSexp(sexp);
     }
     std::cout << "\n";
     printingStackSize = false;
@@ -564,7 +573,62 @@ void checkUserInterrupt() {
     }
 }
 
+// OSR continuations, cached per loop header and the types of the stack they
+// were compiled for, a failed compilation as nullptr. Functions above
+// PIR_MAX_INPUT_SIZE are never optimized as a whole, for them these are the
+// compiled regions of their hot loops (see Compiler::compileContinuation).
+// The entry of a loop header preserves its continuations and the baseline the
+// header points into, until it is invalidated.
+struct OsrContinuation {
+    std::vector<pir::PirType> stack;
+    Function* fun;
+};
+struct OsrEntry {
+    SEXP baseline = nullptr;
+    std::vector<OsrContinuation> versions;
+};
+static std::unordered_map<Opcode*, OsrEntry> osrContinuations;
+static std::unordered_map<Opcode*, unsigned> osrInvalidations;
+
+static void releaseOsrVersions(OsrEntry& e) {
+    for (auto& v : e.versions)
+        if (v.fun)
+            R_ReleaseObject(v.fun->container());
+    e.versions.clear();
+}
+
+// A speculation in a continuation failed. Its feedback was updated, thus the
+// next hot iteration compiles the continuations of this code again. After
+// PIR_DEOPT_ABANDON times the loop is left in the interpreter, only a failed
+// compilation is cached for it.
+static void invalidateOsrContinuations(Code* c) {
+    for (auto i = osrContinuations.begin(); i != osrContinuations.end();) {
+        if (i->first < c->code() || i->first >= c->endCode()) {
+            ++i;
+        } else if (++osrInvalidations[i->first] <
+                   pir::Parameter::DEOPT_ABANDON) {
+            releaseOsrVersions(i->second);
+            R_ReleaseObject(i->second.baseline);
+            i = osrContinuations.erase(i);
+        } else {
+            if (osrInvalidations[i->first] == pir::Parameter::DEOPT_ABANDON)
+                osrStats.abandoned++;
+            // A failure which matches every stack. The baseline stays
+            // preserved, since the header is still a key.
+            auto& entry = i->second;
+            auto stackSize = entry.versions.front().stack.size();
+            releaseOsrVersions(entry);
+            entry.versions.push_back(
+                {std::vector<pir::PirType>(stackSize, pir::PirType::any()),
+                 nullptr});
+            ++i;
+        }
+    }
+}
+
 void recordDeoptReason(SEXP val, const DeoptReason& reason) {
+    if (!osrContinuations.empty())
+        invalidateOsrContinuations(reason.srcCode);
     Opcode* pos = (Opcode*)reason.srcCode + reason.originOffset;
     switch (reason.reason) {
     case DeoptReason::DeadBranchReached: {
@@ -941,6 +1005,20 @@ unsigned pir::Parameter::RIR_WARMUP =
     getenv("PIR_WARMUP") ? atoi(getenv("PIR_WARMUP")) : 3;
 unsigned pir::Parameter::DEOPT_ABANDON =
     getenv("PIR_DEOPT_ABANDON") ? atoi(getenv("PIR_DEOPT_ABANDON")) : 10;
+bool pir::Parameter::PIR_OSR =
+    !getenv("PIR_OSR") || 0 != strncmp("0", getenv("PIR_OSR"), 1);
+unsigned pir::Parameter::PIR_OSR_THRESHOLD =
+    getenv("PIR_OSR_THRESHOLD") ? atoi(getenv("PIR_OSR_THRESHOLD")) : 100000;
+bool pir::Parameter::PIR_REGIONS =
+    !getenv("PIR_REGIONS") || 0 != strncmp("0", getenv("PIR_REGIONS"), 1);
+bool pir::Parameter::DEOPTLESS =
+    getenv("PIR_DEOPTLESS") && 0 == strncmp("1", getenv("PIR_DEOPTLESS"), 1);
+unsigned pir::Parameter::DEOPTLESS_MAX_CONTINUATIONS =
+    getenv("PIR_DEOPTLESS_MAX_CONTINUATIONS")
+        ? atoi(getenv("PIR_DEOPTLESS_MAX_CONTINUATIONS"))
+        : 5;
+bool pir::Parameter::RIR_PACK_DOTS =
+    !getenv("PIR_PACK_DOTS") || 0 != strncmp("0", getenv("PIR_PACK_DOTS"), 1);
 
 static unsigned serializeCounter = 0;
 
@@ -1032,8 +1110,39 @@ static SEXP rirCallCallerProvidedEnv(CallContext& call, Function* fun,
     return res;
 }
 
+// Optimized versions of closures with dots formals require the arguments to be
+// statically matched, i.e. `...` is passed as a DOTSXP at its formal position.
+// PIR callers create this DotsList themselves. For positional calls the
+// interpreter can do the same by packing the surplus arguments.
+static bool canPackDots(const CallContext& call, const FunctionSignature& sig,
+                        InterpreterInstance* ctx) {
+    if (!sig.hasDotsFormals || call.suppliedArgs <= sig.dotsPosition ||
+        !call.stackArgs || call.arglist ||
+        call.callId != ArglistOrder::NOT_REORDERED ||
+        call.givenContext.includes(Assumption::StaticallyArgmatched))
+        return false;
+    for (size_t i = 0; i < call.suppliedArgs; ++i) {
+        if (call.hasNames() && call.name(i, ctx) != R_NilValue)
+            return false;
+        if (TYPEOF(call.stackArg(i)) == DOTSXP)
+            return false;
+    }
+    return true;
+}
+
+static SEXP rirCallPackingDots(CallContext& call, size_t dotsPosition,
+                               InterpreterInstance* ctx);
+
 // Call a RIR function. Arguments are still untouched.
 RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
+    if (pir::Parameter::RIR_PACK_DOTS) {
+        auto& sig = DispatchTable::unpack(BODY(call.callee))
+                        ->baseline()
+                        ->signature();
+        if (canPackDots(call, sig, ctx))
+            return rirCallPackingDots(call, sig.dotsPosition, ctx);
+    }
+
     SEXP body = BODY(call.callee);
     if (pir::Parameter::RIR_SERIALIZE_CHAOS) {
         serializeCounter++;
@@ -1047,12 +1156,28 @@ RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
 
     auto table = DispatchTable::unpack(body);
 
+    if (pir::Parameter::BACKGROUND_COMPILE && !isDeoptimizing())
+        pir::BackgroundCompilation::installFinished();
+
     inferCurrentContext(call, table->baseline()->signature().formalNargs(),
                         ctx);
     Function* fun = dispatch(call, table);
     fun->registerInvocation();
 
-    if (!isDeoptimizing() && RecompileHeuristic(table, fun)) {
+    // This closure is hot for the first time in this process: compile the
+    // versions of earlier runs from the cache, instead of profiling it further
+    if (pir::CodeCache::enabled() && table->size() == 1 && !isDeoptimizing() &&
+        !fun->flags.contains(Function::CodeCacheChecked) &&
+        RecompileHeuristic(table, fun)) {
+        fun->flags.set(Function::CodeCacheChecked);
+        SEXP lhs = CAR(call.ast);
+        SEXP name = TYPEOF(lhs) == SYMSXP ? lhs : R_NilValue;
+        if (pir::CodeCache::restore(call.callee, table, name, ctx))
+            fun = dispatch(call, table);
+    }
+
+    if (!isDeoptimizing() && RecompileHeuristic(table, fun) &&
+        !pir::BackgroundCompilation::inFlight(table)) {
         Context given = call.givenContext;
         // addDynamicAssumptionForOneTarget compares arguments with the
         // signature of the current dispatch target. There the number of
@@ -1068,6 +1193,19 @@ RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
             }
         }
     }
+
+    // Hot tier-1 version: recompile with the full LLVM pipeline
+    if (pir::Parameter::PIR_LLVM_TIERING &&
+        fun->flags.contains(Function::Tier1) && !isDeoptimizing() &&
+        fun->invocationCount() + fun->body()->loopCount >=
+            pir::Parameter::PIR_LLVM_TIER2_THRESHOLD &&
+        !pir::BackgroundCompilation::inFlight(table)) {
+        SEXP lhs = CAR(call.ast);
+        SEXP name = TYPEOF(lhs) == SYMSXP ? lhs : R_NilValue;
+        fun->flags.reset(Function::Tier1);
+        ctx->closureTierUpOptimizer(call.callee, fun->context(), name);
+        fun = dispatch(call, table);
+    }
     bool needsEnv = fun->signature().envCreation ==
                     FunctionSignature::Environment::CallerProvided;
 
@@ -1080,6 +1218,7 @@ RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
         call.callId,
         call.caller ? call.caller->arglistOrderContainer() : nullptr,
         call.suppliedArgs, call.stackArgs, call.ast);
+    SEXP promargs = call.promargs ? call.promargs : lazyPromargs.asSexp();
 
     SEXP result;
     if (!needsEnv) {
@@ -1088,14 +1227,13 @@ RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
         SEXP arglist = call.arglist;
         if (!arglist) {
             assert(call.stackArgs);
-            arglist = lazyPromargs.asSexp();
+            arglist = promargs;
         }
 
         supplyMissingArgs(call, fun);
         result = rirCallTrampoline(call, fun, arglist, ctx);
     } else {
-        result =
-            rirCallCallerProvidedEnv(call, fun, lazyPromargs.asSexp(), ctx);
+        result = rirCallCallerProvidedEnv(call, fun, promargs, ctx);
     }
 
     if (pir::Parameter::RIR_SERIALIZE_CHAOS) {
@@ -1106,6 +1244,43 @@ RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
     return result;
 }
 
+// Pushes a copy of the arguments up to the dots, followed by a DOTSXP of the
+// remaining ones, and calls the closure as statically argmatched. Formals after
+// the dots can only be matched by name, thus they are missing. The promargs
+// still list the arguments as supplied.
+static SEXP rirCallPackingDots(CallContext& call, size_t dotsPosition,
+                               InterpreterInstance* ctx) {
+    SEXP promargs = createEnvironmentFrameFromStackValues(call, ctx);
+    PROTECT(promargs);
+
+    for (size_t i = 0; i < dotsPosition; ++i)
+        ostack_push(ctx, call.stackArg(i));
+    ostack_push(ctx, R_NilValue);
+    SEXP dots = R_NilValue;
+    for (size_t i = call.suppliedArgs; i > dotsPosition; --i) {
+        auto arg = call.stackArg(i - 1);
+        INCREMENT_NAMED(arg);
+        dots = CONS_NR(arg, dots);
+        ostack_set(ctx, 0, dots);
+    }
+    SET_TYPEOF(dots, DOTSXP);
+
+    CallContext packed(ArglistOrder::NOT_REORDERED, call.caller, call.callee,
+                       dotsPosition + 1, call.ast,
+                       ostack_cell_at(ctx, dotsPosition), nullptr,
+                       call.callerEnv, call.givenContext, ctx);
+    // inferCurrentContext recomputes the argument types for the new positions
+    packed.givenContext.clearTypeFlags();
+    packed.givenContext.add(Assumption::StaticallyArgmatched);
+    packed.promargs = promargs;
+    packed.siteCache = call.siteCache;
+
+    auto res = rirCall(packed, ctx);
+    ostack_popn(ctx, packed.passedArgs);
+    UNPROTECT(1);
+    return res;
+}
+
 #ifdef DEBUG_SLOWCASES
 class SlowcaseCounter {
   public:
@@ -1201,8 +1376,36 @@ SEXP dispatchApply(SEXP ast, SEXP obj, SEXP actuals, SEXP selector,
     RCNTXT cntxt;
     initClosureContext(ast, &cntxt, rho1, callerEnv, actuals, op);
     SEXP result;
-    bool success = Rf_usemethod(generic, obj, ast, actuals, rho1, callerEnv,
-                                R_BaseEnv, &result);
+    bool success;
+    SEXP methodSym;
+    if (auto method = S3Cache::get(ast, selector, obj, callerEnv, methodSym)) {
+        // Same as dispatchMethod in GNU R, for a method of the first class
+        SEXP dotMethod = PROTECT(Rf_ScalarString(PRINTNAME(methodSym)));
+        SEXP dotGeneric = PROTECT(Rf_mkString(generic));
+        SEXP vars = R_NilValue;
+        auto var = [&](SEXP tag, SEXP val) {
+            // cons protects its args if needed
+            vars = CONS_NR(val, vars);
+            SET_TAG(vars, tag);
+        };
+        var(symbol::DotGenericDefEnv, R_BaseEnv);
+        var(symbol::DotGenericCallEnv, callerEnv);
+        var(symbol::DotGroup, R_BlankScalarString);
+        var(symbol::DotMethod, dotMethod);
+        var(symbol::DotClass, Rf_getAttrib(obj, R_ClassSymbol));
+        var(symbol::DotGeneric, dotGeneric);
+        PROTECT(vars);
+        SEXP call = PROTECT(Rf_shallow_duplicate(ast));
+        SETCAR(call, methodSym);
+        cntxt.callflag = CTXT_GENERIC;
+        result = Rf_applyClosure(call, method, actuals, callerEnv, vars);
+        cntxt.callflag = CTXT_RETURN;
+        UNPROTECT(4);
+        success = true;
+    } else {
+        success = Rf_usemethod(generic, obj, ast, actuals, rho1, callerEnv,
+                               R_BaseEnv, &result);
+    }
     UNPROTECT(1);
     endClosureContext(&cntxt, success ? result : R_NilValue);
     if (success)
@@ -1370,6 +1573,15 @@ static SEXPREC createFakeCONS(SEXP cdr) {
 
 #define STORE_BINOP(res_type, int_res, real_res)                               \
     do {                                                                       \
+        if (consumesUnboxed()) {                                               \
+            ostack_popn(ctx, 2);                                               \
+            if (res_type == INTSXP)                                            \
+                ostack_push_int(ctx, int_res);                                 \
+            else                                                               \
+                ostack_push_real(ctx, real_res);                               \
+            scalarStats.unboxed++;                                             \
+            break;                                                             \
+        }                                                                      \
         SEXP a = ostack_at(ctx, 0);                                            \
         SEXP b = ostack_at(ctx, 1);                                            \
         if (NO_REFERENCES(a)) {                                                \
@@ -1377,13 +1589,16 @@ static SEXPREC createFakeCONS(SEXP cdr) {
             res = a;                                                           \
             ostack_pop(ctx);                                                   \
             ostack_at(ctx, 0) = a;                                             \
+            scalarStats.reused++;                                              \
         } else if (NO_REFERENCES(b)) {                                         \
             TYPEOF(b) = res_type;                                              \
             res = b;                                                           \
             ostack_pop(ctx);                                                   \
+            scalarStats.reused++;                                              \
         } else {                                                               \
             ostack_pop(ctx);                                                   \
             ostack_at(ctx, 0) = res = Rf_allocVector(res_type, 1);             \
+            scalarStats.boxed++;                                               \
         }                                                                      \
         switch (res_type) {                                                    \
         case INTSXP:                                                           \
@@ -1942,6 +2157,103 @@ SEXP colonCastRhs(SEXP newLhs, SEXP rhs) {
     return result;
 }
 
+// Replaces the unboxed scalar on top of the stack by a box
+static SEXP boxTop(InterpreterInstance* ctx) {
+    auto top = ostack_cell_at(ctx, 0);
+    SEXP res = top->tag == INTSXP ? ScalarInteger(top->u.ival)
+                                  : ScalarReal(top->u.dval);
+    ostack_set(ctx, 0, res);
+    scalarStats.boxed++;
+    return res;
+}
+
+// Stores the unboxed scalar on top of the stack into the binding cell loc, by
+// overwriting the current value (see updateBoundScalar). Unlike in
+// rirDefineVarWrapper the value must also not be on the stack of the function
+// (e.g. as a loop sequence), since it was never boxed.
+static bool storeUnboxed(SEXP loc, R_bcstack_t* frameBase) {
+    if (!loc || BINDING_IS_LOCKED(loc) || IS_ACTIVE_BINDING(loc))
+        return false;
+    auto top = R_BCNodeStackTop - 1;
+    SEXP cur = CAR(loc);
+    for (auto s = frameBase; s < top; ++s)
+        if (s->tag == 0 && s->u.sxpval == cur)
+            return false;
+
+    bool updated = top->tag == INTSXP ? updateBoundScalar(cur, top->u.ival)
+                                      : updateBoundScalar(cur, top->u.dval);
+    if (!updated)
+        return false;
+    if (MISSING(loc))
+        SET_MISSING(loc, 0);
+    scalarStats.updatedInPlace++;
+    return true;
+}
+
+static bool isRegionCode(Code* c) {
+    return pir::Parameter::PIR_REGIONS &&
+           c->inputSize() > pir::Parameter::MAX_INPUT_SIZE;
+}
+
+// On-stack replacement is only done in the baseline version of a function
+// body, which was started from the beginning. Not in promises and not in
+// frames reconstructed by a deopt, to avoid deopt loops.
+static bool osrPossible(Code* c, SEXP env, const CallContext* callCtxt,
+                        Opcode* initialPC) {
+    if (initialPC || !callCtxt || TYPEOF(env) != ENVSXP || isDeoptimizing())
+        return false;
+    auto callee = callCtxt->callee;
+    if (!callee || TYPEOF(callee) != CLOSXP ||
+        !DispatchTable::check(BODY(callee)))
+        return false;
+    auto baseline = DispatchTable::unpack(BODY(callee))->baseline();
+    return baseline->body() == c &&
+           (!baseline->flags.contains(Function::NotOptimizable) ||
+            isRegionCode(c));
+}
+
+// The continuation of the loop at pc for the current stack. Only compiles a
+// new one if compile is set.
+static Function* osrContinuation(InterpreterInstance* ctx, SEXP callee,
+                                 Opcode* pc, R_bcstack_t* stack,
+                                 size_t stackSize, SEXP name, bool compile) {
+    std::vector<pir::PirType> types;
+    for (size_t i = 0; i < stackSize; ++i) {
+        auto v = stack[i].u.sxpval;
+        types.push_back(TYPEOF(v) == PROMSXP ? pir::PirType::any()
+                                             : pir::PirType(v));
+    }
+
+    auto entry = osrContinuations.find(pc);
+    if (entry != osrContinuations.end()) {
+        for (auto& e : entry->second.versions) {
+            bool matches = true;
+            for (size_t i = 0; i < types.size(); ++i)
+                if (!types[i].isA(e.stack[i]))
+                    matches = false;
+            if (matches)
+                return e.fun;
+        }
+    }
+    if (!compile)
+        return nullptr;
+
+    auto fun = ctx->continuationCompiler(callee, pc, stack, stackSize, name);
+    osrStats.compiles++;
+    if (fun)
+        R_PreserveObject(fun->container());
+    else
+        osrStats.failures++;
+    // The cache is keyed by pc, the baseline must not be collected
+    if (entry == osrContinuations.end()) {
+        auto baseline = DispatchTable::unpack(BODY(callee))->baseline();
+        R_PreserveObject(baseline->container());
+        osrContinuations[pc].baseline = baseline->container();
+    }
+    osrContinuations[pc].versions.push_back({types, fun});
+    return fun;
+}
+
 SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                  const CallContext* callCtxt, Opcode* initialPC,
                  BindingCache* cache) {
@@ -1986,6 +2298,10 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
     // some intermediate values on the stack
     ostack_ensureSize(ctx, c->stackLength + 5);
 
+    // The stack of this frame and the number of back-edges taken, for OSR
+    R_bcstack_t* frameBase = R_BCNodeStackTop;
+    unsigned loopCounter = 0;
+
     Opcode* pc;
 
     if (initialPC) {
@@ -2018,6 +2334,23 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             feedback->stateBeforeLastForce = state;
     };
 
+    // Scalar results of arithmetic are left unboxed on the stack, if the next
+    // instruction (after recording its type) stores or drops them. All other
+    // instructions only ever see boxed values. Logicals are not unboxed,
+    // relops already push the shared R_TrueValue etc. without allocating. Stores can update the bound
+    // value in place, see storeUnboxed. This needs the whole stack of the
+    // function, thus not in promises or frames started in the middle.
+    bool unboxedStores = callCtxt && !initialPC;
+    auto consumesUnboxed = [&]() {
+        if (!unboxedStores)
+            return false;
+        auto next = pc;
+        if (*next == Opcode::record_type_)
+            next += 1 + sizeof(ObservedValues);
+        return *next == Opcode::stvar_ || *next == Opcode::stvar_cached_ ||
+               *next == Opcode::pop_;
+    };
+
     // main loop
     BEGIN_MACHINE {
 
@@ -2041,7 +2374,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         INSTRUCTION(ldfun_) {
             SEXP sym = readConst(ctx, readImmediate());
             advanceImmediate();
-            res = Rf_findFun(sym, env);
+            res = GlobalCells::findFun(sym, env);
 
             // TODO something should happen here
             if (res == R_UnboundValue)
@@ -2152,7 +2485,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             SEXP sym = readConst(ctx, readImmediate());
             advanceImmediate();
             assert(!LazyEnvironment::check(env));
-            res = Rf_findVar(sym, env);
+            res = GlobalCells::findVar(sym, env);
             R_Visible = TRUE;
 
             recordForceBehavior(res);
@@ -2257,10 +2590,22 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             SEXP sym = readConst(ctx, readImmediate());
             advanceImmediate();
             SLOWASSERT(TYPEOF(sym) == SYMSXP);
-            SEXP val = ostack_top(ctx);
 
             assert(!LazyEnvironment::check(env));
 
+            if (ostack_top_tag(ctx)) {
+                SEXP loc = nullptr;
+                if (env != R_BaseEnv && env != R_BaseNamespace)
+                    loc = R_findVarLocInFrame(env, sym).cell;
+                if (!storeUnboxed(loc, frameBase)) {
+                    SEXP val = boxTop(ctx);
+                    rirDefineVarWrapper(sym, val, env);
+                }
+                ostack_pop(ctx);
+                NEXT();
+            }
+
+            SEXP val = ostack_top(ctx);
             rirDefineVarWrapper(sym, val, env);
             ostack_pop(ctx);
             NEXT();
@@ -2271,10 +2616,21 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             Immediate cacheIndex = readImmediate();
             advanceImmediate();
-            SEXP val = ostack_pop(ctx);
 
             assert(!LazyEnvironment::check(env));
 
+            if (ostack_top_tag(ctx)) {
+                SEXP loc = getCellFromCache(env, id, cacheIndex, ctx,
+                                            bindingCache);
+                if (!storeUnboxed(loc, frameBase)) {
+                    SEXP val = boxTop(ctx);
+                    cachedSetVar(val, env, id, cacheIndex, ctx, bindingCache);
+                }
+                ostack_pop(ctx);
+                NEXT();
+            }
+
+            SEXP val = ostack_pop(ctx);
             cachedSetVar(val, env, id, cacheIndex, ctx, bindingCache);
             NEXT();
         }
@@ -2313,8 +2669,12 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
 
         INSTRUCTION(record_type_) {
             ObservedValues* feedback = (ObservedValues*)pc;
-            SEXP t = ostack_top(ctx);
-            feedback->record(t);
+            if (auto tag = ostack_top_tag(ctx)) {
+                feedback->recordScalar(tag);
+            } else {
+                SEXP t = ostack_top(ctx);
+                feedback->record(t);
+            }
             pc += sizeof(ObservedValues);
             NEXT();
         }
@@ -2332,10 +2692,13 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             Context given(pc);
             pc += sizeof(Context);
+            auto cache = (CallSiteCache*)pc;
+            pc += sizeof(CallSiteCache);
 
             CallContext call(ArglistOrder::NOT_REORDERED, c, ostack_at(ctx, n),
                              n, ast, ostack_cell_at(ctx, (long)n - 1), env,
                              given, ctx);
+            call.siteCache = cache;
             res = doCall(call, ctx);
             ostack_popn(ctx, call.passedArgs + 1);
             ostack_push(ctx, res);
@@ -2358,11 +2721,14 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             Context given(pc);
             pc += sizeof(Context);
+            auto cache = (CallSiteCache*)pc;
+            pc += sizeof(CallSiteCache);
             auto names = (Immediate*)pc;
             advanceImmediateN(n);
             CallContext call(ArglistOrder::NOT_REORDERED, c, ostack_at(ctx, n),
                              n, ast, ostack_cell_at(ctx, (long)n - 1), names,
                              env, given, ctx);
+            call.siteCache = cache;
             res = doCall(call, ctx);
             ostack_popn(ctx, call.passedArgs + 1);
             ostack_push(ctx, res);
@@ -2384,6 +2750,8 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             Context given(pc);
             pc += sizeof(Context);
+            auto cache = (CallSiteCache*)pc;
+            pc += sizeof(CallSiteCache);
             auto names_ = (Immediate*)pc;
             advanceImmediateN(n);
 
@@ -2404,6 +2772,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             CallContext call(ArglistOrder::NOT_REORDERED, c, callee, n, ast,
                              ostack_cell_at(ctx, (long)n - 1), names, env,
                              given, ctx);
+            call.siteCache = cache;
             res = doCall(call, ctx);
             ostack_popn(ctx, call.passedArgs + 1 + pushed);
             ostack_push(ctx, res);
@@ -3085,6 +3454,30 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             checkUserInterrupt();
             pc += offset;
             PC_BOUNDSCHECK(pc, c);
+            // Hot loop: continue in optimized code from the loop header. A
+            // continuation compiled in an earlier call is entered early, it
+            // is looked up after 1, 2, 4, ... iterations.
+            if (offset < 0 && pir::Parameter::PIR_OSR &&
+                (++loopCounter == pir::Parameter::PIR_OSR_THRESHOLD ||
+                 ((loopCounter & (loopCounter - 1)) == 0 &&
+                  osrContinuations.count(pc))) &&
+                osrPossible(c, env, callCtxt, initialPC)) {
+                size_t stackSize = R_BCNodeStackTop - frameBase;
+                SEXP lhs = CAR(callCtxt->ast);
+                SEXP name = TYPEOF(lhs) == SYMSXP ? lhs : R_NilValue;
+                if (auto fun = osrContinuation(
+                        ctx, callCtxt->callee, pc, frameBase, stackSize, name,
+                        loopCounter == pir::Parameter::PIR_OSR_THRESHOLD)) {
+                    osrStats.entries++;
+                    auto code = fun->body();
+                    PROTECT(fun->container());
+                    res = code->nativeCode(code, frameBase, env,
+                                           callCtxt->callee);
+                    UNPROTECT(1);
+                    ostack_popn(ctx, stackSize);
+                    return res;
+                }
+            }
             NEXT();
         }
 
@@ -98,7 +98,8 @@ inline bool matches(const CallContext& call, Function* f) {
 }
 
 inline Function* dispatch(const CallContext& call, DispatchTable* vt) {
-    auto f = vt->dispatch(call.givenContext);
+    auto f = call.siteCache ? vt->dispatch(call.givenContext, call.siteCache)
+                            : vt->dispatch(call.givenContext);
     assert(f);
     return f;
 };
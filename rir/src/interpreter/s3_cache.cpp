@@ -0,0 +1,109 @@
+#include "s3_cache.h"
+#include "R/Symbols.h"
+#include "compiler/parameter.h"
+
+#include <cstring>
+#include <string>
+
+namespace rir {
+
+bool pir::Parameter::RIR_S3_CACHE =
+    !getenv("PIR_S3_CACHE") || 0 != strncmp("0", getenv("PIR_S3_CACHE"), 1);
+
+namespace {
+
+struct Entry {
+    SEXP ast;
+    SEXP generic;
+    // The first class, CHARSXPs are cached and can be compared by identity
+    SEXP cls;
+    // `generic.class`
+    SEXP sym;
+};
+
+constexpr size_t ENTRIES = 256;
+Entry entries[ENTRIES];
+
+// Keeps ast and cls of all entries alive, such that their addresses cannot be
+// reused while they are cached
+SEXP alive() {
+    static SEXP store = nullptr;
+    if (!store) {
+        store = Rf_allocVector(VECSXP, 2 * ENTRIES);
+        R_PreserveObject(store);
+    }
+    return store;
+}
+
+size_t slot(SEXP ast, SEXP cls) {
+    auto h = (uintptr_t)ast ^ ((uintptr_t)cls >> 5);
+    return (h >> 4) % ENTRIES;
+}
+
+// The function bound to sym in the frame rho, R_UnboundValue if there is none
+// and nullptr if a promise would have to be forced to tell
+SEXP funInFrame(SEXP rho, SEXP sym) {
+    auto v = Rf_findVarInFrame3(rho, sym, TRUE);
+    if (TYPEOF(v) == PROMSXP) {
+        if (PRVALUE(v) == R_UnboundValue)
+            return nullptr;
+        v = PRVALUE(v);
+    }
+    auto t = TYPEOF(v);
+    if (t == CLOSXP || t == BUILTINSXP || t == SPECIALSXP)
+        return v;
+    return R_UnboundValue;
+}
+
+// The first two steps of R_LookupMethod, which looks in the frames from the
+// caller to its top env and then in the S3 methods table of the generic's
+// defining env, base for the internal generics
+SEXP lookupMethod(SEXP sym, SEXP callerEnv) {
+    auto top = Rf_topenv(R_NilValue, callerEnv);
+    for (auto rho = callerEnv; rho != R_EmptyEnv; rho = ENCLOS(rho)) {
+        auto f = funInFrame(rho, sym);
+        if (f != R_UnboundValue)
+            return f;
+        if (rho == top)
+            break;
+    }
+    auto table =
+        Rf_findVarInFrame3(R_BaseNamespace, symbol::S3MethodsTable, TRUE);
+    if (TYPEOF(table) != ENVSXP)
+        return nullptr;
+    auto f = funInFrame(table, sym);
+    return f == R_UnboundValue ? nullptr : f;
+}
+
+} // namespace
+
+SEXP S3Cache::get(SEXP ast, SEXP generic, SEXP obj, SEXP callerEnv,
+                  SEXP& methodSym) {
+    if (!pir::Parameter::RIR_S3_CACHE || IS_S4_OBJECT(obj) ||
+        TYPEOF(callerEnv) != ENVSXP)
+        return nullptr;
+    auto klass = Rf_getAttrib(obj, R_ClassSymbol);
+    if (TYPEOF(klass) != STRSXP || XLENGTH(klass) == 0)
+        return nullptr;
+    auto cls = STRING_ELT(klass, 0);
+
+    auto i = slot(ast, cls);
+    auto& e = entries[i];
+    if (e.ast != ast || e.generic != generic || e.cls != cls) {
+        std::string name = CHAR(PRINTNAME(generic));
+        name += ".";
+        name += CHAR(cls);
+        SET_VECTOR_ELT(alive(), 2 * i, ast);
+        SET_VECTOR_ELT(alive(), 2 * i + 1, cls);
+        e = {ast, generic, cls, Rf_install(name.c_str())};
+    }
+
+    auto method = lookupMethod(e.sym, callerEnv);
+    if (!method || TYPEOF(method) != CLOSXP || RDEBUG(method) ||
+        RSTEP(method))
+        return nullptr;
+    methodSym = e.sym;
+    return method;
+}
+
+} // namespace rir
@@ -0,0 +1,40 @@
+#ifndef RIR_S3_CACHE_H
+#define RIR_S3_CACHE_H
+
+#include "R/r.h"
+
+namespace rir {
+
+/*
+ * Cache for the S3 dispatch of `[`, `[[` and `[<-` on objects. A site (the
+ * call ast) usually sees the same few classes. For the first class of an
+ * object the site remembers the method symbol `generic.class`, such that
+ * neither the class vector has to be computed nor the method name be built
+ * and installed on every dispatch.
+ *
+ * The method itself is looked up again on every dispatch, the way
+ * R_LookupMethod does, but only for this one symbol and only in the frames
+ * from the caller up to its top env and in the S3 methods table of base. Thus
+ * methods which are (re)defined, registered or removed later are always
+ * picked up. If the first class has no method there, the site falls back to
+ * the full dispatch of GNU R.
+ *
+ * Closure generics calling UseMethod are not cached. UseMethod is a special
+ * of GNU R, which sets up the method's context itself, thus they always go
+ * through its full usemethod lookup.
+ *
+ * TODO: cache the method of UseMethod in closure generics too, which needs
+ * our own version of GNU R's dispatchMethod (copying the generic's locals,
+ * returning from the generic's context). Then let rir2pir speculate on the
+ * cached method of a site and inline it.
+ */
+struct S3Cache {
+    // The closure dispatching `generic` on obj would call, and the symbol of
+    // the method, or nullptr if it cannot be determined cheaply.
+    static SEXP get(SEXP ast, SEXP generic, SEXP obj, SEXP callerEnv,
+                    SEXP& methodSym);
+};
+
+} // namespace rir
+
+#endif
@@ -64,16 +64,23 @@ void BC::write(CodeStream& cs) const {
         cs.insert(immediate.guard_fun_args);
         return;
 
-    case Opcode::call_:
-        cs.insert(immediate.callFixedArgs);
+    case Opcode::call_: {
+        // The inline cache is specific to one instance of the instruction
+        auto args = immediate.callFixedArgs;
+        args.cache.reset();
+        cs.insert(args);
         break;
+    }
 
     case Opcode::named_call_:
-    case Opcode::call_dots_:
-        cs.insert(immediate.callFixedArgs);
+    case Opcode::call_dots_: {
+        auto args = immediate.callFixedArgs;
+        args.cache.reset();
+        cs.insert(args);
         for (PoolIdx name : callExtra().callArgumentNames)
             cs.insert(name);
         break;
+    }
 
     case Opcode::call_builtin_:
         cs.insert(immediate.callBuiltinFixedArgs);
@@ -158,6 +165,7 @@ void BC::deserialize(SEXP refTable, R_inpstream_t inp, Opcode* code,
             i.callFixedArgs.nargs = InInteger(inp);
             i.callFixedArgs.ast = Pool::insert(ReadItem(refTable, inp));
             InBytes(inp, &i.callFixedArgs.given, sizeof(Context));
+            i.callFixedArgs.cache.reset();
             Opcode* c = code + 1 + sizeof(CallFixedArgs);
             // Read implicit promise argument offsets
             // Read named arguments
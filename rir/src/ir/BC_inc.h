@@ -14,6 +14,7 @@
 #include <array>
 #include <vector>
 
+#include "runtime/CallSiteCache.h"
 #include "runtime/Context.h"
 #include "runtime/TypeFeedback.h"
 
@@ -91,7 +92,10 @@ class BC {
         NumArgs nargs;
         Immediate ast;
         Context given;
+        CallSiteCache cache;
     };
+    static_assert(sizeof(CallFixedArgs) == 16 * sizeof(Immediate),
+                  "keep in sync with the call instructions in insns.h");
     struct CallBuiltinFixedArgs {
         NumArgs nargs;
         Immediate ast;
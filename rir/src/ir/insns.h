@@ -79,15 +79,17 @@ DEF_INSTR(stvar_super_, 1, 1, 0, 1)
  *         on top of the callee; these arguments can be
  *         values, promises (even preseeded w/ a value), or R_MissingValue for
  *         exlicitly missing arguments.
+ *         The immediates are nargs, ast, the given context and an inline
+ *         cache for dispatch (see CallSiteCache.h).
  */
-DEF_INSTR(call_, 4, -1, 1, 0)
+DEF_INSTR(call_, 16, -1, 1, 0)
 
 /*
  * named_call_:: Same as above, but with names for the arguments as immediates
  *               THIS IS A VARIABLE LENGTH INSTRUCTION
- *               the actual number of immediates is 3 + nargs
+ *               the actual number of immediates is 16 + nargs
  */
-DEF_INSTR(named_call_, 4, -1, 1, 0)
+DEF_INSTR(named_call_, 16, -1, 1, 0)
 
 /*
  * call_dots_:: This instruction is like named_call_, but additionally it
@@ -95,7 +97,7 @@ DEF_INSTR(named_call_, 4, -1, 1, 0)
  *              argument will be expanded (on the stack) with the contents of
  *              `...` and passed to the callee.
  */
-DEF_INSTR(call_dots_, 4, -1, 1, 0)
+DEF_INSTR(call_dots_, 16, -1, 1, 0)
 
 /**
  * call_builtin_:: Like static call, but calls a builtin
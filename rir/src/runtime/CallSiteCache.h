@@ -0,0 +1,54 @@
+#ifndef RIR_CALL_SITE_CACHE_H
+#define RIR_CALL_SITE_CACHE_H
+
+#include "Context.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace rir {
+
+struct Function;
+
+#pragma pack(push)
+#pragma pack(1)
+
+// Inline cache of a call instruction. Remembers which version the dispatch
+// table selected for the last few contexts seen at this site.
+//
+// Entries are tagged with the stamp of the dispatch table at the time of
+// caching. Stamps are unique across all tables and every change to a table
+// (insert, remove, eviction) gives it a new one. Thus a matching stamp
+// guarantees that the table is the same object as before, that it did not
+// change, and that the cached function is still installed (and alive). The
+// cache therefore holds no references the GC needs to know about.
+struct CallSiteCache {
+    static constexpr unsigned Entries = 2;
+
+    struct Entry {
+        // 0 means empty
+        uint64_t stamp;
+        Context context;
+        Function* fun;
+    };
+    Entry entries[Entries];
+
+    CallSiteCache() { reset(); }
+
+    void reset() { memset((void*)this, 0, sizeof(*this)); }
+
+    // Most recently used entry first
+    void add(uint64_t stamp, const Context& context, Function* fun) {
+        for (unsigned i = Entries - 1; i > 0; --i)
+            entries[i] = entries[i - 1];
+        entries[0].stamp = stamp;
+        entries[0].context = context;
+        entries[0].fun = fun;
+    }
+};
+
+#pragma pack(pop)
+
+} // namespace rir
+
+#endif
@@ -18,8 +18,8 @@ Code::Code(FunctionSEXP fun, SEXP src, unsigned srcIdx, unsigned cs,
           (intptr_t)&locals_ - (intptr_t)this,
           // GC area has only 1 pointer
           NumLocals),
-      nativeCode(nullptr), funInvocationCount(0), deoptCount(0), src(srcIdx),
-      trivialExpr(nullptr), stackLength(0), localsCount(localsCnt),
+      nativeCode(nullptr), funInvocationCount(0), deoptCount(0), loopCount(0),
+      src(srcIdx), trivialExpr(nullptr), stackLength(0), localsCount(localsCnt),
       bindingCacheSize(bindingsCnt), codeSize(cs), srcLength(sourceLength),
       extraPoolSize(0) {
     setEntry(0, R_NilValue);
@@ -27,6 +27,22 @@ Code::Code(FunctionSEXP fun, SEXP src, unsigned srcIdx, unsigned cs,
         trivialExpr = src;
 }
 
+size_t Code::inputSize(Opcode* begin, Opcode* end) const {
+    size_t res = end - begin;
+    for (auto pc = begin; pc < end; pc = BC::next(pc)) {
+        switch (*pc) {
+        case Opcode::call_:
+        case Opcode::named_call_:
+        case Opcode::call_dots_:
+            res -= sizeof(CallSiteCache);
+            break;
+        default:
+            break;
+        }
+    }
+    return res;
+}
+
 Code* Code::New(SEXP ast, size_t codeSize, size_t sources, size_t locals,
                 size_t bindingCache) {
     auto src = src_pool_add(globalContext(), ast);
@@ -96,6 +112,7 @@ Code* Code::deserialize(SEXP refTable, R_inpstream_t inp) {
     code->nativeCode = nullptr; // not serialized for now
     code->funInvocationCount = InInteger(inp);
     code->deoptCount = InInteger(inp);
+    code->loopCount = 0;
     code->src = InInteger(inp);
     bool hasTr = InInteger(inp);
     if (hasTr)
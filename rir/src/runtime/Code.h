@@ -98,6 +98,9 @@ struct Code : public RirRuntimeObject<Code, CODE_MAGIC> {
     // of a function
     unsigned funInvocationCount;
     unsigned deoptCount;
+    // number of loop iterations executed by tier-1 native code of this body.
+    // Runtime only, not serialized.
+    unsigned loopCount;
 
     enum Flag {
         NeedsFullEnv,
@@ -149,6 +152,11 @@ struct Code : public RirRuntimeObject<Code, CODE_MAGIC> {
     Opcode* code() const { return (Opcode*)data; }
     Opcode* endCode() const { return (Opcode*)((uintptr_t)code() + codeSize); }
 
+    // Bytes of bytecode in [begin, end) the compiler sees, without the inline
+    // caches of the call instructions. Compared against MAX_INPUT_SIZE.
+    size_t inputSize(Opcode* begin, Opcode* end) const;
+    size_t inputSize() const { return inputSize(code(), endCode()); }
+
     // Usually SEXP pointers are loaded through the const pool. But sometimes
     // we want to be able to attach things to the code objects which:
     // 1. should get collected when the code is not longer needed
@@ -1,6 +1,7 @@
 #ifndef RIR_DISPATCH_TABLE_H
 #define RIR_DISPATCH_TABLE_H
 
+#include "CallSiteCache.h"
 #include "Function.h"
 #include "R/Serialize.h"
 #include "RirRuntimeObject.h"
@@ -40,6 +41,31 @@ struct DispatchTable
     }
 
     Function* dispatch(Context a) const {
+        auto& cached = dispatchCache_[dispatchCacheSlot(a)];
+        if (cached.idx != DispatchCacheEntry::EMPTY && cached.context == a)
+            return get(cached.idx);
+
+        auto i = lookup(a);
+        cached.context = a;
+        cached.idx = i;
+        return get(i);
+    }
+
+    // Dispatch through the inline cache of a call site first
+    Function* dispatch(Context a, CallSiteCache* site) const {
+        for (auto& e : site->entries) {
+            if (e.stamp == stamp_ && e.context == a &&
+                !e.fun->flags.contains(Function::Dead))
+                return e.fun;
+        }
+        auto f = dispatch(a);
+        site->add(stamp_, a, f);
+        return f;
+    }
+
+    // Index of the most specific version compatible with a. More specialized
+    // versions come first, so the first match wins.
+    size_t lookup(Context a) const {
         if (!a.smaller(userDefinedContext_)) {
 #ifdef DEBUG_DISPATCH
             std::cout << "DISPATCH trying: " << a
@@ -54,14 +80,15 @@ struct DispatchTable
                       << "\n";
 #endif
             if (a.smaller(get(i)->context()))
-                return get(i);
+                return i;
         }
-        return baseline();
+        return 0;
     }
 
     void baseline(Function* f) {
         assert(f->signature().optimization ==
                FunctionSignature::OptimizationLevel::Baseline);
+        invalidateCaches();
         if (size() == 0)
             size_++;
         else
@@ -78,6 +105,7 @@ struct DispatchTable
     }
 
     void remove(Code* funCode) {
+        invalidateCaches();
         size_t i = 1;
         for (; i < size(); ++i) {
             if (get(i)->body() == funCode)
@@ -99,6 +127,7 @@ struct DispatchTable
         assert(size() > 0);
         assert(fun->signature().optimization !=
                FunctionSignature::OptimizationLevel::Baseline);
+        invalidateCaches();
         auto assumptions = fun->context();
         long i;
         for (i = size() - 1; i > 0; --i) {
@@ -108,6 +137,7 @@ struct DispatchTable
                 if (i != 0) {
                     get(i)->flags.set(Function::Dead);
                     setEntry(i, fun->container());
+                    newest_ = fun;
                     assert(get(i) == fun);
                 }
                 return;
@@ -129,8 +159,17 @@ struct DispatchTable
             std::cout << "Tried to insert: " << assumptions << "\n";
             Rf_error("dispatch table overflow");
 #endif
-            // Evict one element and retry
-            auto pos = 1 + (std::rand() % (size() - 1));
+            // Evict the least used version and retry. The newest version
+            // had no time to be used yet, it is only evicted if it is the
+            // only one.
+            size_t pos = 0;
+            for (size_t j = 1; j < size(); ++j)
+                if (get(j) != newest_ &&
+                    (!pos ||
+                     get(j)->invocationCount() < get(pos)->invocationCount()))
+                    pos = j;
+            if (!pos)
+                pos = 1;
             size_--;
             while (pos < size()) {
                 setEntry(pos, getEntry(pos + 1));
@@ -143,6 +182,7 @@ struct DispatchTable
             setEntry(j, getEntry(j - 1));
         size_++;
         setEntry(i, fun->container());
+        newest_ = fun;
 
 #ifdef DEBUG_DISPATCH
         std::cout << "Added version to DT, new order is: \n";
@@ -161,6 +201,7 @@ struct DispatchTable
     }
 
     static DispatchTable* create(size_t capacity = 20) {
+        assert(capacity < DispatchCacheEntry::EMPTY);
         size_t sz =
             sizeof(DispatchTable) + (capacity * sizeof(DispatchTableEntry));
         SEXP s = Rf_allocVector(EXTERNALSXP, sz);
@@ -194,6 +235,14 @@ struct DispatchTable
                 get(i)->serialize(refTable, out);
     }
 
+    // Must be called on every change to the table. Clears the dispatch cache
+    // and invalidates all call site caches referring to this table.
+    void invalidateCaches() {
+        for (auto& e : dispatchCache_)
+            e.idx = DispatchCacheEntry::EMPTY;
+        stamp_ = nextStamp();
+    }
+
     Context userDefinedContext() const { return userDefinedContext_; }
     DispatchTable* newWithUserContext(Context udc) {
 
@@ -224,10 +273,34 @@ struct DispatchTable
               // GC area starts at the end of the DispatchTable
               sizeof(DispatchTable),
               // GC area is just the pointers in the entry array
-              cap) {}
+              cap),
+          stamp_(nextStamp()) {}
+
+    static uint64_t nextStamp() {
+        static uint64_t stamp = 0;
+        return ++stamp;
+    }
 
     size_t size_ = 0;
     Context userDefinedContext_;
+    uint64_t stamp_;
+    // The last inserted version, only compared by identity
+    Function* newest_ = nullptr;
+
+    // Direct mapped cache from the exact context of a call to the index of
+    // the version it dispatched to. Hot call sites only ever see a handful
+    // of contexts, thus they skip the linear search of dispatch. Indices
+    // are invalidated by every change to the table.
+    struct DispatchCacheEntry {
+        static constexpr uint8_t EMPTY = 0xff;
+        Context context;
+        uint8_t idx = EMPTY;
+    };
+    static constexpr size_t DISPATCH_CACHE_SIZE = 8;
+    static size_t dispatchCacheSlot(const Context& c) {
+        return std::hash<Context>()(c) & (DISPATCH_CACHE_SIZE - 1);
+    }
+    mutable DispatchCacheEntry dispatchCache_[DISPATCH_CACHE_SIZE];
 };
 #pragma pack(pop)
 } // namespace rir
@@ -89,7 +89,9 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
     V(InnerFunction)                                                           \
     V(DisableAllSpecialization)                                                \
     V(DisableArgumentTypeSpecialization)                                       \
-    V(DisableNumArgumentsSpezialization)
+    V(DisableNumArgumentsSpezialization)                                       \
+    V(Tier1)                                                                   \
+    V(CodeCacheChecked)
 
     enum Flag {
 #define V(F) F,
@@ -97,7 +99,7 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
 #undef V
 
             FIRST = Deopt,
-        LAST = DisableNumArgumentsSpezialization
+        LAST = CodeCacheChecked
     };
     EnumSet<Flag> flags;
 
@@ -122,6 +124,17 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
     const FunctionSignature& signature() const { return signature_; }
     const Context& context() const { return context_; }
 
+    // Reported by rir.jitStats. Times are in seconds, the LLVM time and native
+    // code size are the ones of the module this version was compiled in. The
+    // counters at the last reset are subtracted from the reported counts.
+    struct Stats {
+        double pirTime = 0;
+        double llvmTime = 0;
+        size_t nativeBytes = 0;
+        size_t invocationsAtReset = 0;
+    };
+    Stats stats;
+
   private:
     unsigned numArgs_;
 
@@ -0,0 +1,188 @@
+#include "JitStats.h"
+#include "DispatchTable.h"
+#include "R/Protect.h"
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace rir {
+
+namespace {
+
+// Weak references, indexed by their key, the closure. The value is its entry,
+// a list of the name and the deopt counters. A pairlist after a dummy head
+// keeps the weak references alive, in the order of registration.
+enum { ENTRY_NAME, ENTRY_DEOPTS, ENTRY_SIZE };
+enum { DEOPTS, DEOPTS_AT_RESET, DEOPTS_SIZE };
+SEXP registry() {
+    static SEXP head = nullptr;
+    if (!head) {
+        head = Rf_cons(R_NilValue, R_NilValue);
+        R_PreserveObject(head);
+    }
+    return head;
+}
+SEXP registryTail = nullptr;
+std::unordered_map<SEXP, SEXP> byClosure;
+
+// Drops the weak references of collected closures. The address of a collected
+// closure can be reused, thus an entry of byClosure is only valid if the key
+// of its weak reference matches.
+void prune() {
+    for (auto i = byClosure.begin(); i != byClosure.end();) {
+        if (R_WeakRefKey(i->second) != i->first)
+            i = byClosure.erase(i);
+        else
+            ++i;
+    }
+    auto last = registry();
+    while (CDR(last) != R_NilValue) {
+        if (R_WeakRefKey(CAR(CDR(last))) == R_NilValue)
+            SETCDR(last, CDR(CDR(last)));
+        else
+            last = CDR(last);
+    }
+    registryTail = last;
+}
+
+// The registered closures which are still alive, or just what
+std::vector<SEXP> closures(SEXP what) {
+    std::vector<SEXP> res;
+    if (what != R_NilValue) {
+        if (TYPEOF(what) != CLOSXP || !DispatchTable::check(BODY(what)))
+            Rf_error("not a compiled closure");
+        res.push_back(what);
+        return res;
+    }
+    for (auto n = CDR(registry()); n != R_NilValue; n = CDR(n)) {
+        auto closure = R_WeakRefKey(CAR(n));
+        if (closure != R_NilValue && DispatchTable::check(BODY(closure)))
+            res.push_back(closure);
+    }
+    return res;
+}
+
+SEXP entryOf(SEXP closure) {
+    auto i = byClosure.find(closure);
+    if (i == byClosure.end() || R_WeakRefKey(i->second) != closure)
+        return R_NilValue;
+    return R_WeakRefValue(i->second);
+}
+
+std::string nameOf(SEXP entry) {
+    if (entry == R_NilValue)
+        return "";
+    return CHAR(STRING_ELT(VECTOR_ELT(entry, ENTRY_NAME), 0));
+}
+
+double* deoptsOf(SEXP entry) {
+    if (entry == R_NilValue)
+        return nullptr;
+    return REAL(VECTOR_ELT(entry, ENTRY_DEOPTS));
+}
+
+double since(size_t count, size_t atReset) {
+    // Invocations are unregistered again when a call is rejected
+    return count > atReset ? count - atReset : 0;
+}
+
+} // namespace
+
+void JitStats::registerClosure(SEXP closure, const std::string& name) {
+    if (entryOf(closure) != R_NilValue)
+        return;
+    // Pruning when byClosure doubled keeps registration amortized constant
+    static size_t pruneAt = 64;
+    if (!registryTail || byClosure.size() >= pruneAt) {
+        prune();
+        pruneAt = std::max(pruneAt, 2 * byClosure.size());
+    }
+    Protect p;
+    auto entry = p(Rf_allocVector(VECSXP, ENTRY_SIZE));
+    SET_VECTOR_ELT(entry, ENTRY_NAME, Rf_mkString(name.c_str()));
+    auto deopts = Rf_allocVector(REALSXP, DEOPTS_SIZE);
+    SET_VECTOR_ELT(entry, ENTRY_DEOPTS, deopts);
+    REAL(deopts)[DEOPTS] = REAL(deopts)[DEOPTS_AT_RESET] = 0;
+    auto ref = p(R_MakeWeakRef(closure, entry, R_NilValue, FALSE));
+    SETCDR(registryTail, Rf_cons(ref, R_NilValue));
+    registryTail = CDR(registryTail);
+    byClosure[closure] = ref;
+}
+
+void JitStats::registerDeopt(SEXP closure) {
+    if (auto deopts = deoptsOf(entryOf(closure)))
+        deopts[DEOPTS]++;
+}
+
+SEXP JitStats::report(SEXP what) {
+    auto all = closures(what);
+    size_t rows = 0;
+    for (auto c : all)
+        rows += DispatchTable::unpack(BODY(c))->size();
+
+    const char* names[] = {"name",    "version",     "context",
+                           "optimized", "invocations", "deopts",
+                           "pirTime", "llvmTime",    "nativeBytes",
+                           ""};
+    Protect p;
+    auto res = p(Rf_mkNamed(VECSXP, names));
+    auto name = p(Rf_allocVector(STRSXP, rows));
+    auto version = p(Rf_allocVector(INTSXP, rows));
+    auto context = p(Rf_allocVector(STRSXP, rows));
+    auto optimized = p(Rf_allocVector(LGLSXP, rows));
+    std::vector<SEXP> reals;
+    for (size_t i = 0; i < 5; ++i)
+        reals.push_back(p(Rf_allocVector(REALSXP, rows)));
+
+    size_t row = 0;
+    for (auto c : all) {
+        auto dt = DispatchTable::unpack(BODY(c));
+        auto entry = entryOf(c);
+        auto closureName = nameOf(entry);
+        auto deopts = deoptsOf(entry);
+        for (size_t i = 0; i < dt->size(); ++i, ++row) {
+            auto fun = dt->get(i);
+            std::stringstream ctx;
+            ctx << fun->context();
+            SET_STRING_ELT(name, row, Rf_mkChar(closureName.c_str()));
+            INTEGER(version)[row] = i;
+            SET_STRING_ELT(context, row, Rf_mkChar(ctx.str().c_str()));
+            LOGICAL(optimized)[row] =
+                fun->signature().optimization !=
+                FunctionSignature::OptimizationLevel::Baseline;
+            auto& stats = fun->stats;
+            REAL(reals[0])[row] =
+                since(fun->invocationCount(), stats.invocationsAtReset);
+            REAL(reals[1])[row] =
+                i == 0 && deopts ? deopts[DEOPTS] - deopts[DEOPTS_AT_RESET]
+                                 : 0;
+            REAL(reals[2])[row] = stats.pirTime;
+            REAL(reals[3])[row] = stats.llvmTime;
+            REAL(reals[4])[row] = stats.nativeBytes;
+        }
+    }
+
+    SET_VECTOR_ELT(res, 0, name);
+    SET_VECTOR_ELT(res, 1, version);
+    SET_VECTOR_ELT(res, 2, context);
+    SET_VECTOR_ELT(res, 3, optimized);
+    for (size_t i = 0; i < reals.size(); ++i)
+        SET_VECTOR_ELT(res, 4 + i, reals[i]);
+    return res;
+}
+
+void JitStats::reset(SEXP what) {
+    for (auto c : closures(what)) {
+        auto dt = DispatchTable::unpack(BODY(c));
+        for (size_t i = 0; i < dt->size(); ++i) {
+            auto fun = dt->get(i);
+            fun->stats.invocationsAtReset = fun->invocationCount();
+        }
+        if (auto deopts = deoptsOf(entryOf(c)))
+            deopts[DEOPTS_AT_RESET] = deopts[DEOPTS];
+    }
+}
+
+} // namespace rir
@@ -0,0 +1,34 @@
+#ifndef RIR_JIT_STATS_H
+#define RIR_JIT_STATS_H
+
+#include "R/r.h"
+
+#include <string>
+
+namespace rir {
+
+/*
+ * Per version telemetry of compiled closures, see rir.jitStats. Closures are
+ * registered when PIR compiles them. The registry only holds weak references,
+ * thus it does not keep closures alive.
+ *
+ * The counts of a version are reported relative to the last reset. The
+ * counters in the Code objects are left untouched, since the tiering
+ * heuristics depend on them.
+ *
+ * A deopt removes the version from the dispatch table, thus deopts are
+ * counted per closure in the registry and reported on its baseline row.
+ */
+struct JitStats {
+    static void registerClosure(SEXP closure, const std::string& name);
+    static void registerDeopt(SEXP closure);
+
+    // A list of columns with one row per version of the closure what, or of
+    // all registered closures if what is NULL
+    static SEXP report(SEXP what);
+    static void reset(SEXP what);
+};
+
+} // namespace rir
+
+#endif
@@ -138,7 +138,14 @@ struct ObservedValues {
         attribs = attribs || object || ATTRIB(e) != R_NilValue;
         notFastVecelt = notFastVecelt || !fastVeceltOk(e);
 
-        uint8_t type = TYPEOF(e);
+        recordType(TYPEOF(e));
+    }
+
+    // A simple scalar, which is unboxed on the interpreter stack
+    RIR_INLINE void recordScalar(uint8_t type) { recordType(type); }
+
+  private:
+    RIR_INLINE void recordType(uint8_t type) {
         if (numTypes < MaxTypes) {
             int i = 0;
             for (; i < numTypes; ++i) {